@@ -10,67 +10,234 @@
 #include <fstream>
 #include <thread>
 #include <ctime>
+#include <chrono>
 #include <queue>
+#include <mutex>
+#include <atomic>
+#include <tuple>
 #include "board.h"
 #include "action.h"
+#include "bitboard.h"
+#include "network.h"
+#include "pattern.h"
+#include "mast.h"
+#include "topology.h"
 
 using namespace std;
 
-default_random_engine engine;
+/**
+ * random engine of the calling thread, padded to a cache line so that the engines of
+ * different threads never share one; each thread is seeded from the base seed when first used
+ */
+struct alignas(64) thread_random {
+    default_random_engine engine;
+    thread_random(unsigned seed) : engine(seed) {}
+};
+inline atomic<unsigned>& random_base(){
+    static atomic<unsigned> base(5489u);
+    return base;
+}
+inline atomic<unsigned>& random_threads(){
+    static atomic<unsigned> count(0);
+    return count;
+}
+inline default_random_engine& random_engine(){
+    static thread_local thread_random r(random_base() + random_threads()++ * 0x9e3779b9u);
+    return r.engine;
+}
+// reseed the engine of the calling thread, and the engines of the threads started afterwards
+inline void seed_random_engines(unsigned seed){
+    random_base() = seed;
+    random_threads() = 1;
+    random_engine().seed(seed);
+}
+
+/**
+ * options of the playout policy, shared by all nodes of a tree
+ * cutoff: check every cutoff moves whether the result is decided by eyes, a heuristic (0 disables)
+ * net: evaluate the leaves by the policy/value network instead of playouts (NULL disables)
+ * patterns: sample the playout moves by the weights of their 3x3 patterns, and give the new
+ *           children a progressive bias (NULL: uniformly random moves, no bias)
+ * mast: weight the playout moves by their win rates in the earlier playouts as well (NULL disables)
+ * playouts: the playouts run by the tree so far, counted by simulate
+ */
+struct playout_options {
+    int cutoff=0;
+    evaluator* net=NULL;
+    const pattern_table* patterns=NULL;
+    const mast_table* mast=NULL;
+    mutable uint64_t playouts=0;
+};
+
+/**
+ * free list of node storage of a NUMA node, alive for the whole process so that the nodes freed by
+ * pruning or by advancing a tree (on any thread) are reused by the search threads of later moves;
+ * new storage is first touched by the thread allocating it, hence on its node
+ *
+ * the list is lock-free: a freed block is pushed by a CAS, and a thread that runs out of blocks takes
+ * the whole list at once into its own cache (neither can suffer from ABA), which it gives back when
+ * it exits; about 'limit' blocks are kept per node, the rest are returned to the heap
+ */
+struct node_pool {
+    enum { limit = 1 << 16 };
+    struct block { block* next; };
+    atomic<block*> head{nullptr};
+    atomic<size_t> size{0};
+
+    void push(block* first, block* last, size_t n){
+        last->next = head.load(memory_order_relaxed);
+        while(!head.compare_exchange_weak(last->next, first, memory_order_release, memory_order_relaxed));
+        size += n;
+    }
+    block* take(){
+        size = 0;
+        return head.exchange(nullptr, memory_order_acquire);
+    }
+    ~node_pool(){
+        for(block* b = head; b; ){
+            block* next = b->next;
+            ::operator delete(b);
+            b = next;
+        }
+    }
+
+    static node_pool& of(int node){
+        static node_pool pools[topology::max_nodes];
+        return pools[node];
+    }
+
+    /**
+     * blocks the calling thread took from the pool of its node
+     */
+    struct cache {
+        block* head = nullptr;
+        int node = 0;
+        ~cache(){
+            if(!head) return;
+            block* last = head;
+            size_t n = 1;
+            for(; last->next; last = last->next) n++;
+            of(node).push(head, last, n);
+        }
+    };
+    static cache& local(){
+        static thread_local cache c;
+        return c;
+    }
+
+    static void* allocate(size_t size){
+        cache& c = local();
+        if(!c.head){
+            c.node = topology::current_node();
+            c.head = of(c.node).take();
+            if(!c.head) return ::operator new(size);
+        }
+        block* b = c.head;
+        c.head = b->next;
+        return b;
+    }
+    static void release(void* ptr){
+        node_pool& p = of(topology::current_node());
+        if(p.size.load(memory_order_relaxed) >= limit){
+            ::operator delete(ptr);
+            return;
+        }
+        block* b = static_cast<block*>(ptr);
+        p.push(b, b, 1);
+    }
+};
 
 class MCTS_node {
 public:
     board::piece_type who;
     board::piece_type me;
     bool terminal=0;
+    int proven=0; // +1: proven win for me, -1: proven loss for me, 0: unknown
     unsigned int size;
     unsigned int number_of_simulations;
     unsigned int rave_number_of_simulations;
     double rave_score;
     double score;
+    float prior=0;
+    float bias=0; // progressive bias of the pattern of the move
+    vector<float> priors;
     board* state;
     vector<MCTS_node*> *child;
     vector<MCTS_node*> Map_Action2Child;
-    action::place* move;
+    placement move;
     MCTS_node* parent;
-    vector<action::place*> *untried_actions;
+    vector<placement> *untried_actions;
 
-    MCTS_node(MCTS_node *parent, board* state, action::place* move, board::piece_type who, board::piece_type me)
+    MCTS_node(MCTS_node *parent, board* state, placement move, board::piece_type who, board::piece_type me)
          : parent(parent), state(state), score(0.0), move(move), number_of_simulations(0), size(0), who(who), me(me) 
          ,rave_number_of_simulations(40), rave_score(32.0){
-        untried_actions = new vector<action::place*>;
+        untried_actions = new vector<placement>;
         Map_Action2Child.resize((board::size_x)*(board::size_y), NULL);
         for(int i=0;i < (board::size_x)*(board::size_y);i++){
             board::point mv(i);
-            board after = *state;
-            if(after.place(mv) == board::legal){
-                action::place* tmp = new action::place(mv,who);
-                untried_actions->push_back(tmp);
+            if(state->check(mv) == board::legal){
+                untried_actions->emplace_back(mv, who);
             }
         }
         if(untried_actions->size() == 0)terminal = 1;
-        shuffle(untried_actions->begin(), untried_actions->end(), engine);
+        if(terminal) proven = (who == me ? -1 : 1); // the side to move has no legal move and loses
+        shuffle(untried_actions->begin(), untried_actions->end(), random_engine());
         child = new vector<MCTS_node*>;
     }
     ~MCTS_node(){
         delete state;
-        delete move;
         for(auto *ch:*child) delete ch;
         delete child;
-        while(!untried_actions->empty()) {
-            delete untried_actions->back();
-            untried_actions->pop_back();
-        }
         delete untried_actions;
     }
     bool is_fully_expanded(){
         return terminal || untried_actions->empty();
     }
 
+#if !defined(__SANITIZE_ADDRESS__) // with AddressSanitizer, nodes are freed to the heap, where a use after free is caught
+    static void* operator new(size_t size){
+        return node_pool::allocate(size);
+    }
+    static void operator delete(void* ptr){
+        node_pool::release(ptr);
+    }
+#endif
+
+    /**
+     * estimated heap memory held by this node: the node, its board, its child and untried_actions
+     * vectors, the buffers of all its vectors, and the allocator overhead of each of these blocks
+     */
+    size_t footprint() const {
+        const size_t overhead = 2 * sizeof(size_t);
+        auto block = [&](size_t bytes) -> size_t { return bytes ? bytes + overhead : 0; };
+        return block(sizeof(MCTS_node)) + block(sizeof(board))
+             + block(sizeof(vector<MCTS_node*>)) + block(sizeof(vector<placement>))
+             + block(Map_Action2Child.capacity() * sizeof(MCTS_node*))
+             + block(child->capacity() * sizeof(MCTS_node*))
+             + block(untried_actions->capacity() * sizeof(placement))
+             + block(priors.capacity() * sizeof(float));
+    }
+    size_t subtree_footprint() const {
+        size_t total = footprint();
+        for(auto *ch:*child) total += ch->subtree_footprint();
+        return total;
+    }
+
+    /**
+     * remove a child (and its subtree) from this node, its action becomes untried again
+     * so that the node can expand it later
+     */
+    void detach(MCTS_node* ch){
+        child->erase(find(child->begin(), child->end(), ch));
+        Map_Action2Child[ch->move.i] = NULL;
+        untried_actions->insert(untried_actions->begin(), ch->move);
+    }
+
     void backpropagate(double w,int n, set<int>* history){
 
         number_of_simulations += n;
         score += w;
+        update_proven();
 
         for(auto i:*history){
             if(Map_Action2Child[i]!=NULL){
@@ -85,33 +252,98 @@ public:
             parent->backpropagate(w,n,history);
         }
     }
-    void expand(){
+    /**
+     * MCTS-Solver: a node is a proven win for the side to move if any child is,
+     * and a proven loss if it is fully expanded and every child is a proven loss
+     */
+    void update_proven(){
+        if(proven || terminal) return;
+        int want = (who == me ? 1 : -1);
+        bool all = untried_actions->empty();
+        for(auto *ch:*child){
+            if(ch->proven == want){
+                proven = want;
+                return;
+            }
+            if(ch->proven != -want) all = false;
+        }
+        if(all) proven = -want;
+    }
+
+    /**
+     * expand one untried action, evaluate the new node and backpropagate its value
+     * return the new node, or NULL if there is nothing to expand
+     */
+    MCTS_node* expand(const playout_options& opt){
+        NOGO_PROFILE_SCOPE(expand);
         if(terminal){
-            return;
+            return NULL;
         }
         else if(is_fully_expanded()){
-            return;
+            return NULL;
         }
-        action::place* next_move = untried_actions->back();
+        placement next_move = untried_actions->back();
         untried_actions->pop_back();
         
         board* next_state = new board(*state);
-        next_state->place(next_move->position());
+        next_state->play(next_move.position());
         
         MCTS_node* new_node = new MCTS_node(this, next_state, next_move, swt(who), me);
         
-        Map_Action2Child[next_move->position().i] = new_node;
-        
+        Map_Action2Child[next_move.i] = new_node;
+        if(!priors.empty()) new_node->prior = priors[next_move.i];
+        if(opt.patterns != NULL) new_node->bias = opt.patterns->bias(state->pattern(next_move.i), who);
+        child->push_back(new_node);
+
+        new_node->evaluate(opt);
+        return new_node;
+    }
+
+    /**
+     * expand the given action if it is untried, return its child (NULL if it is not a legal action)
+     */
+    MCTS_node* expand(const playout_options& opt, const placement& move){
+        auto it = find_if(untried_actions->begin(), untried_actions->end(), [&](const placement& a){ return a.i == move.i; });
+        if(it == untried_actions->end()) return Map_Action2Child[move.i];
+        swap(*it, untried_actions->back());
+        return expand(opt);
+    }
+
+    /**
+     * evaluate this node by the network or by a playout, and backpropagate the value
+     */
+    void evaluate(const playout_options& opt){
         set<int>* travelhistory = new set<int>;
 
-        int value = simulate(*new_node->state, new_node->who);
+        double value;
+        if(opt.net != NULL && !terminal){
+            network::output out = opt.net->evaluate(*state);
+            if(priors.empty()) set_priors(out.policy);
+            value = (who == me ? 1 - out.value : 1 + out.value) / 2; // the chance that me loses
+        }
+        else{
+            value = simulate(*state, who, opt);
+        }
 
-        new_node->backpropagate(value, 1, travelhistory);
+        {
+            NOGO_PROFILE_SCOPE(backpropagate);
+            backpropagate(value, 1, travelhistory);
+        }
         
         travelhistory->clear();
         delete travelhistory;
+    }
 
-        child->push_back(new_node);
+    /**
+     * store the move priors given by the network, the untried actions are
+     * ordered so that the action with the highest prior is expanded first
+     */
+    void set_priors(const float* policy){
+        priors.assign(policy, policy + (board::size_x)*(board::size_y));
+        for(auto *ch:*child) ch->prior = priors[ch->move.i];
+        sort(untried_actions->begin(), untried_actions->end(), [&](const placement& a, const placement& b){
+            return priors[a.i] < priors[b.i];
+        });
     }
 
     //Use to do leaf parallelization
@@ -125,31 +357,95 @@ public:
         return total;
     }
 
-    int simulate(board b, board::piece_type op){
-        action::place* mv = get_random_move(b, op);
-        while(mv != NULL){
-            //s->insert(mv->position().i);
-            b.place(mv->position());
+    /**
+     * play a random game from b, in place, and take its moves back before returning
+     * return 1 if me loses the game
+     */
+    int simulate(board& b, board::piece_type op, const playout_options& opt){
+        NOGO_PROFILE_SCOPE(simulate);
+        opt.playouts++;
+        int base = b.moves(), result = -1;
+        mast_table::local_copy* mast = opt.mast != NULL ? &opt.mast->local() : NULL;
+        int played[board::size_x * board::size_y], n = 0;
+        unsigned first = b.info().who_take_turns;
+        for(int step=1;result == -1;step++){
+            int mv = get_random_move(b, opt.patterns, mast != NULL ? mast->weight[b.info().who_take_turns - 1] : NULL);
+            if(mv == -1){
+                result = (op == me);
+                break;
+            }
+            b.play(mv);
+            played[n++] = mv;
             op = swt(op);
-            mv = get_random_move(b, op);
+            if(opt.cutoff && step % opt.cutoff == 0){
+                board::piece_type loser = decided(b);
+                if(loser != board::empty) result = (loser == me);
+            }
         }
-        return (op == me);
+        while(b.moves() > base) b.undo();
+        if(mast != NULL) opt.mast->update(*mast, played, n, first, result ? swt(me) : me);
+        return result;
     }
 
-    action::place* get_random_move(board b, board::piece_type op){
-        vector<action::place*> move;
+    /**
+     * a heuristic end of the playout, computed from the pattern codes the board keeps up to date:
+     * the side to have lost is returned once the other side has more eyes (empty points whose
+     * orthogonal neighbors are all its stones, hollow, or outside, which the side can never play)
+     * than the side has eyes and other empty points together, or board::empty if undecided
+     * this is not a proof, the owner may fill its own eyes or be unable to play them, so it only
+     * ends the playout with that result, and never marks a node proven
+     */
+    board::piece_type decided(const board& b){
+        int eyes[3] = {}, open = 0;
+        for(int i = 0; i < board::size_x * board::size_y; i++){
+            if(b(i) != board::empty) continue;
+            uint16_t code = b.pattern(i);
+            unsigned seen = 0; // the states of the orthogonal neighbors, at the odd positions of the code
+            for(int k = 1; k < 8; k += 2) seen |= 1u << ((code >> (k * 2)) & 3);
+            seen &= ~(1u << board::hollow);
+            if(seen == (1u << board::black)) eyes[board::black]++;
+            else if(seen == (1u << board::white)) eyes[board::white]++;
+            else if(seen) open++; // an empty neighbor, or stones of both sides
+        }
+        if(eyes[board::black] > eyes[board::white] + open) return board::white;
+        if(eyes[board::white] > eyes[board::black] + open) return board::black;
+        return board::empty;
+    }
+
+    /**
+     * a random legal move of the side to move, in proportion to the weights of the patterns
+     * and the MAST weights of the points, if given (uniformly without both), or -1 if it has none
+     * a few candidates are drawn by rejection first, which costs O(1) legality checks
+     * while the board is open; all legal moves are weighted only if they all fail
+     */
+    int get_random_move(const board& b, const pattern_table* table, const float* gibbs = NULL){
+        default_random_engine& gen = random_engine();
+        unsigned who = b.info().who_take_turns;
+        uniform_int_distribution<int> any(0, board::size_x * board::size_y - 1);
+        uniform_real_distribution<float> coin(0, table != NULL ? table->max() : 1);
+        for(int tries = 0; tries < 16; tries++){
+            int i = any(gen);
+            if(b(i) != board::empty) continue;
+            if((table != NULL || gibbs != NULL) && weight(b, i, who, table, gibbs) < coin(gen)) continue;
+            if(b.check(board::point(i)) == board::legal) return i;
+        }
+        int legal[board::size_x * board::size_y], n = 0;
+        float sum[board::size_x * board::size_y], total = 0;
         for(int i = 0 ; i < (board::size_x) * (board::size_y) ; i++){
-            board::point mv(i);
-            board after = b;
-            if(after.place(mv) == board::legal){
-                action::place* tmp = new action::place(mv,op);
-                move.push_back(tmp);
-            }
+            if(b(i) != board::empty || b.check(board::point(i)) != board::legal) continue;
+            total += weight(b, i, who, table, gibbs);
+            legal[n] = i;
+            sum[n++] = total;
         }
-        shuffle(move.begin(), move.end(), engine);
-        if(move.empty()) return NULL;
-        for(int i=1;i<move.size();i++)delete move[i];
-        return move[0];
+        if(n == 0) return -1;
+        float r = uniform_real_distribution<float>(0, total)(gen);
+        return legal[min(int(upper_bound(sum, sum + n, r) - sum), n - 1)];
+    }
+
+    // the weight of point i in get_random_move, at most the maximum of the pattern table (or 1)
+    static float weight(const board& b, int i, unsigned who, const pattern_table* table, const float* gibbs){
+        float w = table != NULL ? table->weight(b.pattern(i), who) : 1;
+        return gibbs != NULL ? w * gibbs[i] : w;
     }
 
     double uct_value(MCTS_node* node, double c, bool RAVE){
@@ -161,7 +457,9 @@ public:
         double rave_winrate = node->rave_score / (1.0 * node->rave_number_of_simulations+1);
         double exploitation = (who != me ? (1-beta) * winrate + beta * rave_winrate : (1-beta) * (1-winrate) + beta * (1-rave_winrate));
         double exploration = sqrt(c * log(this->number_of_simulations+1) / (1.0 * node->number_of_simulations + 1));
-        return exploitation + exploration;
+        if(node->prior > 0) exploration = sqrt(c) * node->prior * sqrt(this->number_of_simulations) / (1.0 * node->number_of_simulations + 1); // PUCT
+        double bias = node->bias / (1.0 * node->number_of_simulations + 1); // progressive bias, fades with the visits
+        return exploitation + exploration + bias;
     }
 
     MCTS_node* select_best_child(double c, bool RAVE){
@@ -170,6 +468,7 @@ public:
         MCTS_node* best = NULL;
 
         for(auto *ch:*child){
+            if(ch->proven) continue; // solved subtrees need no more search
             if(ch->number_of_simulations == 0) return ch;
             
             uct = uct_value(ch, c, RAVE);
@@ -181,10 +480,58 @@ public:
         }
         return best;
     }
+    MCTS_node* find_child(const board& b){
+        for(auto *ch:*child){
+            if(ch->state->hash() == b.hash() && *ch->state == b) return ch;
+        }
+        return NULL;
+    }
+
+    /**
+     * link a detached node as the child of this node, if it is one move away
+     * return false if no untried action of this node leads to its position
+     */
+    bool adopt(MCTS_node* b){
+        for(auto it = untried_actions->begin(); it != untried_actions->end(); it++){
+            state->play(it->position());
+            bool same = state->hash() == b->state->hash() && *state == *b->state;
+            state->undo();
+            if(!same) continue;
+            b->move = *it;
+            b->parent = this;
+            untried_actions->erase(it);
+            Map_Action2Child[b->move.i] = b;
+            child->push_back(b);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * delete every child except 'keep', which is unlinked and left alive,
+     * the actions of all children become untried again
+     */
+    void strip(MCTS_node* keep = NULL){
+        while(!child->empty()){
+            MCTS_node* ch = child->back();
+            detach(ch);
+            if(ch != keep) delete ch;
+        }
+        if(keep != NULL) keep->parent = NULL;
+    }
+
+    /**
+     * strip the nodes deeper than 'depth' plies below this node
+     */
+    void compact(int depth){
+        if(depth <= 0) strip();
+        else for(auto *ch:*child) ch->compact(depth - 1);
+    }
+
     MCTS_node* advance_tree(MCTS_node* b){
         MCTS_node *next = NULL;
         for(auto *ch:*child){
-            if(*ch->state == *b->state){
+            if(ch->state->hash() == b->state->hash() && *ch->state == *b->state){
                 next = ch;
             }
             else {
@@ -193,7 +540,10 @@ public:
         }
         this->child->clear();
         if(next == NULL) next = b;
-        else next->parent = NULL;
+        else {
+            next->parent = NULL;
+            if(next != b) delete b;
+        }
         
         return next;
     }
@@ -208,17 +558,21 @@ public:
         me = who;
         max_time = t;
         RAVE = rave;
-        root = new MCTS_node(NULL, starting, NULL, who, me);
+        root = new MCTS_node(NULL, starting, placement(), who, me);
     }
     ~MCTS_tree() {
-        delete root;
+        if(path.empty() || path.back() != root) delete root;
+        if(!path.empty()) delete path.front();
     }
-    MCTS_node* select(double c=2){
-        MCTS_node *node = root;
+    MCTS_node* select(double c=2, MCTS_node* from=NULL){
+        NOGO_PROFILE_SCOPE(select);
+        MCTS_node *node = from != NULL ? from : root;
 
-        while(!node->terminal){
+        while(!node->terminal && !node->proven){
             if(!node->is_fully_expanded()) return node;
-            else node = node->select_best_child(c, RAVE);
+            MCTS_node *next = node->select_best_child(c, RAVE);
+            if(next == NULL) return node;
+            node = next;
         }
         return node;
     }
@@ -226,17 +580,50 @@ public:
     MCTS_node* select_best_child(){
         return root->select_best_child(0.0, false);
     }
-    int grow(int maxiter, int max_t, double p_stop){
-        MCTS_node* node;
-        int dt;
+    /**
+     * prune the least visited subtrees below the children of the root until the tree uses
+     * at most 3/4 of the memory limit, the parents of pruned subtrees can expand them again
+     * a node is ranked by the fewest visits on its path from the child of the root, and deeper
+     * nodes go first among equals, so that descendants are always pruned before their ancestors,
+     * even below a kept node searched as the root (see advance_kept), whose visits never reach its parent
+     */
+    void prune(){
+        vector<tuple<unsigned int, int, MCTS_node*>> list; // (visits on the path, -depth, node)
+        for(auto *ch:*root->child) collect(ch, ch->number_of_simulations, 1, list);
+        sort(list.begin(), list.end());
+        size_t target = memory_limit / 4 * 3;
+        for(auto& it:list){
+            if(memory <= target) break;
+            MCTS_node* node = get<2>(it);
+            size_t bytes = node->subtree_footprint();
+            node->parent->detach(node);
+            delete node;
+            memory -= min(memory, bytes);
+            pruned_bytes += bytes;
+            pruned_nodes++;
+        }
+        prunes++;
+    }
+    void collect(MCTS_node* node, unsigned int visits, int depth, vector<tuple<unsigned int, int, MCTS_node*>>& list){
+        for(auto *ch:*node->child){
+            unsigned int least = min(visits, ch->number_of_simulations);
+            if(!ch->proven) list.emplace_back(least, -depth, ch);
+            collect(ch, least, depth + 1, list);
+        }
+    }
 
-        time_t start_t, now_t;
-        time(&start_t);
+    /**
+     * run at most maxiter iterations within max_ms milliseconds, return the milliseconds used
+     */
+    int grow(int maxiter, int max_ms, double p_stop){
+        if(parts) return halve(maxiter, max_ms);
+        auto start = chrono::steady_clock::now();
+        auto elapsed = [&]() { return int(chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count()); };
+        if(playout.net != NULL && root->priors.empty() && !root->terminal) root->set_priors(playout.net->evaluate(*root->state).policy);
         for(int i=0;i<maxiter;i++){
-            
-            node = select();
+            if(root->proven) break;
 
-            node->expand();
+            iterate();
 
             int max1=0, max2=0;
             for(auto *ch:*root->child){
@@ -252,22 +639,153 @@ public:
                 }
             }
 
-            time(&now_t);
-            dt = difftime(now_t, start_t);
-            
-            if(dt > max_t){
-                cout << "Early stopping: Made " << (i+1) << "iterations in " << dt << " seconds." << endl;
+            int dt = elapsed();
+            if(dt > max_ms){
+                cerr << "Early stopping: Made " << (i+1) << " iterations in " << dt << " ms." << endl;
                 break;
             }
         }
-        time(&now_t);
-        dt = difftime(now_t, start_t);
-        return min(dt, max_t);
+        if(playout.mast != NULL) playout.mast->flush();
+        return elapsed();
+    }
+    /**
+     * one iteration: select a leaf below 'from' (the root by default), expand and evaluate it
+     */
+    void iterate(MCTS_node* from=NULL){
+        iterations++;
+        if(memory_limit && memory > memory_limit) prune();
+
+        MCTS_node* node = select(2, from);
+
+        if(memory_limit && memory > memory_limit){
+            node->evaluate(playout); // the tree is full, keep evaluating without expanding
+        }
+        else{
+            size_t before = node->footprint();
+            MCTS_node* leaf = node->expand(playout);
+            if(leaf != NULL) memory += leaf->footprint() + node->footprint() - before; // the parent may grow its child list
+        }
+    }
+
+    /**
+     * search the root by sequential halving instead of UCT: the root moves of this part
+     * (every parts-th legal move, from the part-th) are expanded, then share the budget
+     * in rounds, each candidate getting the same number of iterations (UCT below it),
+     * and the better half by the mean value survives each round; the survivor, or a lone
+     * candidate of the part, gets the rest of the budget, and is kept in halving_move with its
+     * value for the side to move in halving_value and its visits in halving_visits
+     */
+    int halve(int maxiter, int max_ms){
+        auto start = chrono::steady_clock::now();
+        auto elapsed = [&]() { return int(chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count()); };
+        if(playout.net != NULL && root->priors.empty() && !root->terminal) root->set_priors(playout.net->evaluate(*root->state).policy);
+        halving_move = -1;
+        vector<int> moves;
+        for(int i = 0; i < board::size_x * board::size_y; i++){
+            if(root->state->check(board::point(i)) == board::legal) moves.push_back(i);
+        }
+        vector<MCTS_node*> cand;
+        int used = 0;
+        for(size_t k = part; k < moves.size(); k += parts){
+            MCTS_node* ch = root->Map_Action2Child[moves[k]];
+            if(ch == NULL){
+                size_t before = root->footprint();
+                ch = root->expand(playout, placement(moves[k], root->who));
+                if(ch != NULL) memory += ch->footprint() + root->footprint() - before;
+                used++;
+                iterations++; // an expansion with its playout, as in iterate
+            }
+            if(ch != NULL) cand.push_back(ch);
+        }
+        auto value = [&](MCTS_node* ch) -> double {
+            if(ch->proven) return ch->proven > 0 ? 2 : -1;
+            return 1 - ch->score / max(1u, ch->number_of_simulations); // score counts the losses of me
+        };
+        auto better = [&](MCTS_node* a, MCTS_node* b){ return value(a) > value(b); };
+        bool out = false;
+        while(cand.size() > 1 && !root->proven && !out){
+            int rounds = 0;
+            for(size_t n = 1; n < cand.size(); n *= 2) rounds++;
+            int per = max(1, (maxiter - used) / (rounds * int(cand.size())));
+            for(size_t k = 0; k < cand.size() && !out; k++){
+                for(int j = 0; j < per && !cand[k]->proven; j++, used++) iterate(cand[k]);
+                out = elapsed() > max_ms;
+            }
+            stable_sort(cand.begin(), cand.end(), better);
+            if(!out) cand.resize((cand.size() + 1) / 2);
+        }
+        for(; cand.size() == 1 && used < maxiter && !cand[0]->proven && !root->proven && !out; used++){
+            iterate(cand[0]);
+            out = elapsed() > max_ms;
+        }
+        if(out) cerr << "Early stopping: Made " << used << " iterations in " << elapsed() << " ms." << endl;
+        if(cand.size()){
+            stable_sort(cand.begin(), cand.end(), better);
+            halving_move = cand[0]->move.i;
+            halving_value = value(cand[0]);
+            halving_visits = cand[0]->number_of_simulations;
+        }
+        if(playout.mast != NULL) playout.mast->flush();
+        return elapsed();
     }
+
     void advance_tree(MCTS_node* next){
-        MCTS_node* old = root;
-        root = root->advance_tree(next);
-        delete old;
+        if(*root->state == *next->state){ // the position is already the root, e.g., at the first move
+            if(next != root) delete next;
+            return;
+        }
+        if(!path.empty() && path.back() == root){
+            advance_kept(next);
+        }
+        else{
+            MCTS_node* old = root;
+            root = root->advance_tree(next);
+            delete old;
+        }
+        if(memory_limit) memory = root->subtree_footprint();
+    }
+
+    /**
+     * advance the root within the kept plies without deleting any node, the new root is
+     * unlinked from its parent while it is searched and relinked by rewind()
+     * once the game leaves the kept plies, the rest of the game is searched as a separate tree
+     */
+    void advance_kept(MCTS_node* next){
+        MCTS_node* ch = root->find_child(*next->state);
+        if(ch == NULL && int(path.size()) <= keep && root->adopt(next)) ch = next;
+        if(ch != NULL && int(path.size()) <= keep){
+            if(ch != next) delete next;
+            ch->parent = NULL;
+            path.push_back(ch);
+            root = ch;
+            return;
+        }
+        if(int(path.size()) > keep) root->strip(ch); // the root is the last kept ply
+        if(ch != NULL && ch != next) delete next;
+        root = ch != NULL ? ch : next;
+    }
+
+    /**
+     * keep the root and the top 'plies' plies of the tree when it is rewound,
+     * which must be called while the root is still the initial position
+     */
+    void keep_plies(int plies){
+        keep = plies;
+        path.assign(1, root);
+    }
+
+    /**
+     * rewind the tree to the initial position for the next episode, the nodes deeper
+     * than the kept plies are compacted away and their actions become untried again
+     */
+    void rewind(){
+        if(path.empty()) return;
+        if(path.back() != root) delete root;
+        for(size_t i = 1; i < path.size(); i++) path[i]->parent = path[i - 1];
+        root = path.front();
+        path.resize(1);
+        root->compact(keep);
+        if(memory_limit) memory = root->subtree_footprint();
     }
 
     int get_simulation_cnt(int i){
@@ -275,6 +793,37 @@ public:
         return root->Map_Action2Child[i]->number_of_simulations;
     }
 
+    // return the proof of the child of move i for me (+1 win, -1 loss), or 0 if unknown or not expanded
+    int get_proven(int i){
+        if(root->Map_Action2Child[i]==NULL) return 0;
+        return root->Map_Action2Child[i]->proven;
+    }
+
+    /**
+     * the most visited move by the given visits (merged over the trees and helpers), skipping
+     * the moves proven lost in any of the trees unless every visited move is; -1 if none is visited
+     */
+    static int most_visited(const vector<int>& visits, const vector<MCTS_tree*>& trees){
+        int best = -1, best_lost = -1;
+        for(int i=0;i<int(visits.size());i++){
+            if(visits[i] <= 0) continue;
+            bool lost = false;
+            for(auto *t:trees) lost = lost || t->get_proven(i) == -1;
+            int& pick = lost ? best_lost : best;
+            if(pick == -1 || visits[i] > visits[pick]) pick = i;
+        }
+        return best != -1 ? best : best_lost;
+    }
+
+    // return the move of a proven winning child, or -1 if the root is not a proven win
+    int proven_move(){
+        if(root->proven != 1) return -1;
+        for(auto *ch:*root->child){
+            if(ch->proven == 1) return ch->move.i;
+        }
+        return -1;
+    }
+
     double get_winrate(int i){
         if(root->Map_Action2Child[i]==NULL) return 0;
         return root->uct_value(root->Map_Action2Child[i], 0, false);
@@ -286,4 +835,15 @@ public:
     MCTS_node *root=NULL;
     int max_time;
     bool RAVE;
+    playout_options playout;
+    size_t memory=0, memory_limit=0; // estimated bytes held by the tree, and its limit (0: unlimited)
+    size_t prunes=0, pruned_nodes=0, pruned_bytes=0;
+    uint64_t iterations=0;      // the iterations run by grow and halve (with its root expansions), see also playout.playouts
+    int keep=0;                 // plies kept across episodes by rewind()
+    int part=0, parts=0;        // the share of the root moves searched by sequential halving (0 parts: UCT)
+    int halving_move=-1;        // the survivor of the last sequential halving, or -1
+    double halving_value=0;     // its value for the side to move
+    unsigned int halving_visits=0; // and its visits, to compare the survivors of the threads
+    vector<MCTS_node*> path;    // the kept nodes from the initial position to the root, if the root is kept
+    char padding[64];           // keeps the counters of trees grown by different threads on different cache lines
 };
\ No newline at end of file
@@ -118,3 +118,24 @@ protected:
 	action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) white(*a); }
 	static __attribute__((constructor)) void init() { entries()[type_flag('W')] = new white; }
 };
+
+/**
+ * placing move for the search, trivially copyable and applied by a direct call to the board
+ * the point is stored decoded, so nothing is divided, looked up, or allocated on the hot path;
+ * it converts from and to action::place, whose prototype registry is left to the SGF parsing
+ */
+struct placement {
+	int8_t i, x, y; // -1 for no point
+	uint8_t who;
+
+	placement() : i(-1), x(-1), y(-1), who(board::empty) {}
+	placement(int i, unsigned who) : placement(board::point(i), who) {}
+	placement(const board::point& p, unsigned who) : i(p.i), x(p.x), y(p.y), who(who) {}
+	explicit placement(const action& a) : placement(int16_t(a.event() & 0xffff), (a.event() >> 16) & 0xff) {}
+
+	board::point position() const { return board::point(x, y); }
+	board::piece_type color() const { return static_cast<board::piece_type>(who); }
+	board::reward apply(board& b) const { return b.place(x, y, who); }
+	board::reward check(const board& b) const { return b.check(x, y, who); }
+	operator action::place() const { return action::place(i, who); }
+};
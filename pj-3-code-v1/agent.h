@@ -17,9 +17,18 @@
 #include <fstream>
 #include <thread>
 #include <ctime>
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <memory>
 #include "board.h"
 #include "action.h"
 #include "MCTS.h"
+#include "solver.h"
+#include "alphabeta.h"
+#include "record.h"
+#include "book.h"
+#include "shared.h"
 
 class agent {
 public:
@@ -66,6 +75,8 @@ public:
 	}
 	virtual ~random_agent() {}
 
+	void seed(unsigned s) { engine.seed(s); }
+
 protected:
 	std::default_random_engine engine;
 };
@@ -83,31 +94,120 @@ public:
 		if (role() == "black") who = board::black;
 		if (role() == "white") who = board::white;
 		if (meta.count("mcts")) search_algo = "mcts";
+		if (meta.count("search")) search_algo = meta["search"].value;
+		if (search_algo == "MCTS") search_algo = "mcts";
 		if (meta.count("RAVE")) RAVE = true;
 		if (meta.count("simu")) max_iter = meta["simu"];
-		if (meta.count("time")) max_time = meta["time"];
+		if (meta.count("time")) max_time = meta["time"], clocked = true;
+		if (meta.count("depth")) max_depth = meta["depth"];
 		if (meta.count("parallel")) parallel = meta["parallel"];
+		if (meta.count("cutoff")) cutoff = meta["cutoff"];
+		if (meta.count("mem")) memory = meta["mem"];
+		if (meta.count("reuse")) reuse = meta["reuse"];
+		if (meta.count("shared")) shared.reset(new shared_root(meta["shared"], true));
+		if (meta.count("affinity")) cpus = topology::instance().order(meta["affinity"]);
+		if (meta.count("book")) book.reset(new opening_book(meta["book"]));
+		if (meta.count("book_min")) book_min = meta["book_min"];
+		if (meta.count("record")) recorder = shard_writer::open(meta["record"]);
+		if (meta.count("net")) net.reset(new evaluator(meta["net"], std::min(int(meta.count("batch") ? meta["batch"] : 8), parallel)));
+		if (meta.count("pattern")) patterns.reset(meta["pattern"].value == "pattern" ? new pattern_table() : new pattern_table(meta["pattern"].value));
+		if (meta.count("mast")) mast.reset(new mast_table(meta["mast"].value == "mast" ? 1.0 : double(meta["mast"])));
+		if (meta.count("mast_decay")) mast_decay = meta["mast_decay"];
+		if (meta.count("root")) halving = meta["root"].value == "halving";
+		if (meta.count("endgame")) endgame = meta["endgame"];
+		if (meta.count("endgame_nodes")) endgame_nodes = meta["endgame_nodes"];
+		if (meta.count("endgame_time")) endgame_time = meta["endgame_time"];
 		if (who == board::empty)
 			throw std::invalid_argument("invalid role: " + role());
 		for (size_t i = 0; i < space.size(); i++)
-			space[i] = action::place(i, who);
+			space[i] = placement(i, who);
 		trees.resize(parallel, NULL);
 	}
+	virtual ~player() {
+		for(int i=0;i<parallel;i++) delete trees[i];
+	}
 
 	virtual void open_episode(const std::string& flag = "") {
+		if (clock_base < 0) time_left = max_time; // unless the controller already reported the clock
 		for(int i=0;i<parallel;i++) {
+			if(trees[i] != NULL) { // kept from the last episode
+				trees[i]->max_time = max_time;
+				continue;
+			}
 			board* init = new board;
 			trees[i] = new MCTS_tree(init, who, max_time, RAVE);
+			trees[i]->playout.cutoff = cutoff;
+			trees[i]->playout.net = net.get();
+			trees[i]->playout.patterns = patterns.get();
+			trees[i]->playout.mast = mast.get();
+			if(halving) trees[i]->part = i, trees[i]->parts = parallel; // each thread halves its share of the moves
+			trees[i]->memory_limit = size_t(memory) * 1024 * 1024 / parallel;
+			if(reuse) trees[i]->keep_plies(reuse);
 		}
 	}
 
 	virtual void close_episode(const std::string& flag = "") {
-		for(int i=0;i<parallel;i++) delete trees[i];
+		clock_base = -1;
+		stones = 0;
+		for(int i=0;i<parallel;i++) {
+			if(reuse) {
+				trees[i]->rewind();
+			} else {
+				delete trees[i];
+				trees[i] = NULL;
+			}
+		}
+		if (recorder) {
+			for (record& rec : pending) rec.outcome = (flag == name()) ? 1 : -1;
+			recorder->push(std::move(pending));
+			pending.clear();
+		}
 	}
 
 	virtual action take_action(const board& state) {
+		auto start = std::chrono::steady_clock::now();
+		action move = search(state);
+		double used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		time_left -= used;
+		clock_used += used;
+		clock_moves++;
+		return move;
+	}
+
+	/**
+	 * the clock commands of GTP arrive as notifications
+	 *   time=<main seconds>, byoyomi=<seconds>, byoyomi_stones=<moves>: from time_settings
+	 *   time_left=<seconds> (after time_stones=<moves>): from time_left, 0 moves for the main time
+	 */
+	virtual void notify(const std::string& msg) {
+		agent::notify(msg);
+		std::string key = msg.substr(0, msg.find('='));
+		if (key == "time") {
+			max_time = time_left = meta["time"];
+			clock_base = -1;
+			clocked = true;
+		} else if (key == "byoyomi") {
+			byoyomi = meta["byoyomi"];
+		} else if (key == "byoyomi_stones") {
+			byoyomi_stones = meta["byoyomi_stones"];
+		} else if (key == "time_stones") {
+			stones = meta["time_stones"];
+		} else if (key == "time_left") {
+			clocked = true;
+			clock_report(meta["time_left"]);
+		}
+	}
+
+	action search(const board& state) {
+		action move = book_action(state);
+		if (move.type() == action::place::type) return move;
 		if (search_algo == "mcts") {
-		    return mcts_action(state);
+		    auto start = std::chrono::steady_clock::now();
+		    move = endgame_action(state);
+		    if (move.type() == action::place::type) return move;
+		    return mcts_action(state, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		} else if (search_algo == "alpha-beta") {
+		    return alphabeta_action(state);
 		} else {
 		    return random_action(state);
 		}
@@ -115,41 +215,182 @@ public:
 
 	action random_action(const board& state){
 		std::shuffle(space.begin(), space.end(), engine);
-		for (const action::place& move : space) {
-			board after = state;
-			if (move.apply(after) == board::legal)
-				return move;
+		for (const placement& move : space) {
+			if (move.check(state) == board::legal)
+				return action::place(move);
 		}
 		return action();
 	}
 
-	action mcts_action(const board& st){
+	/**
+	 * search by MCTS within the time budget, less the seconds already spent on this move
+	 */
+	action mcts_action(const board& st, double spent = 0){
 		vector<thread> threads;
 
-		for(int i=0;i<parallel;i++) threads.push_back(thread(&player::do_mcts, this, i, st));
+		uint32_t generation = (shared && shared->valid()) ? shared->publish(st) : 0;
+		int budget = time_budget(st, spent);
+		if (mast) mast->decay(mast_decay); // the statistics of the last move fade out
+
+		for(int i=0;i<parallel;i++) threads.push_back(thread(&player::do_mcts, this, i, st, budget));
 		for(int i=0;i<parallel;i++) threads[i].join();
 
-		int best_idx=0;
-		int best_cnt=0;
-		for(int i=0;i<int(board::size_x*board::size_y);i++){
-			int tot=0;
+		int best_idx=-1;
+		double best_value=0;
+		for(int j=0;j<parallel && best_idx == -1;j++) best_idx = trees[j]->proven_move();
+		if(halving && best_idx == -1) { // the best survivor of the threads, among those searched at least half as much as the most searched one
+			unsigned int most = 0;
 			for(int j=0;j<parallel;j++) {
-				tot+=trees[j]->get_simulation_cnt(i);
+				if(trees[j]->halving_move != -1) most = std::max(most, trees[j]->halving_visits);
 			}
-			if(tot > best_cnt) {
-				best_cnt = tot;
-				best_idx = i;
+			for(int j=0;j<parallel;j++) {
+				if(trees[j]->halving_move == -1 || trees[j]->halving_visits * 2 < most) continue;
+				if(best_idx == -1 || trees[j]->halving_value > best_value) best_idx = trees[j]->halving_move, best_value = trees[j]->halving_value;
+			}
+		}
+		vector<int> visits(board::size_x*board::size_y, 0);
+		if(generation) { // the visits of the helper processes
+			shared->merge(generation, visits.data());
+			shared->idle();
+		}
+		int total=0;
+		for(int i=0;i<int(board::size_x*board::size_y);i++){
+			for(int j=0;j<parallel;j++) {
+				visits[i]+=trees[j]->get_simulation_cnt(i);
 			}
+			total+=visits[i];
+		}
+		if(best_idx == -1) best_idx = std::max(0, MCTS_tree::most_visited(visits, trees)); // not a move the solver proved lost
+		if(recorder && total) {
+			double dist[board::size_x*board::size_y];
+			for(int i=0;i<int(board::size_x*board::size_y);i++) dist[i] = 1.0 * visits[i] / total;
+			pending.emplace_back(st, dist);
 		}
- 		action::place move(best_idx, who);
-		board b = st;
-		if(move.apply(b) != board::legal) return action();
+ 		placement move(best_idx, who);
+		if(move.check(st) != board::legal) return action();
 		
+		for(int i=0;i<parallel;i++){ // a tree without the move catches up by the position next time
+			if(trees[i]->root->Map_Action2Child[best_idx] != NULL) trees[i]->advance_tree(trees[i]->root->Map_Action2Child[best_idx]);
+		}
+		if(memory) report_memory();
+		profile::report(std::cerr, name());
+
+		return action::place(move);
+	}
+
+	/**
+	 * play the most visited book move of the position, if it was played at least book_min times
+	 */
+	action book_action(const board& state){
+		if (!book || !book->valid()) return action();
+		int mv = book->lookup(state, book_min);
+		if (mv == -1) return action();
+		placement move(mv, who);
+		if (move.check(state) != board::legal) return action();
+		return action::place(move);
+	}
+
+	/**
+	 * solve the position exactly once fewer than 'endgame' points are legal for either side (0: never)
+	 * return an empty action if the position is too large, not proven won, or the solver times out
+	 * the solver gets at most endgame_time, and no more than the time budget of the move
+	 */
+	action endgame_action(const board& state){
+		position pos(state);
+		if (int((pos.legal(board::black) | pos.legal(board::white)).count()) >= endgame) return action();
+		int best = -1;
+		if (solver.solve(pos, endgame_nodes, std::min(endgame_time, time_budget(state)), &best) != endgame_solver::win) return action();
+		return action::place(best, who);
+	}
+
+	/**
+	 * thinking time in milliseconds for the next move, i.e., the remaining time, less a safety
+	 * margin per move for the latency of the controller, split over the moves still expected:
+	 * the stones of the byo-yomi period, or else estimated by the points legal for the player
+	 * once the main time is used up, each move gets its share of a byo-yomi period instead
+	 * 'spent' is the seconds already used for this move, e.g., by the endgame solver, which
+	 * are charged to time_left only after the move
+	 * without a clock (neither time= nor a report of the controller), the budget is unlimited,
+	 * and only simu= or depth= bounds the search
+	 */
+	int time_budget(const board& state, double spent = 0){
+		if (!clocked) return std::numeric_limits<int>::max();
+		double margin = latency * 1.5 + 0.01;
+		int moves = stones ? stones : position(state).legal(who).count() / 2 + 1;
+		double left = time_left - spent - margin * moves;
+		if (!stones && left <= 0 && byoyomi > 0 && byoyomi_stones > 0)
+			return std::max(0.0, byoyomi / byoyomi_stones - margin - spent) * 1000;
+		return std::max(0.0, left) * 1000 / moves;
+	}
+
+	/**
+	 * take the remaining time reported by the controller, and estimate its latency per move as
+	 * the time it charged beyond the thinking measured here, averaged over the moves since the
+	 * first report of the period, where reports in whole seconds may be rounded by up to a second
+	 */
+	void clock_report(double left){
+		if (clock_base < 0 || left > clock_base) { // the first report, or a new byo-yomi period
+			clock_base = left;
+			clock_used = 0;
+			clock_moves = 0;
+		} else if (clock_moves) {
+			double rounding = (left == std::floor(left) && clock_base == std::floor(clock_base)) ? 1 : 0;
+			latency = std::max(0.01, (clock_base - left - rounding - clock_used) / clock_moves);
+		}
+		time_left = left;
+	}
+
+	action alphabeta_action(const board& state){
+		alphabeta::result res = ab.search(position(state), max_depth, time_budget(state), parallel);
+		if (res.move == -1) return random_action(state);
+		return action::place(res.move, who);
+	}
+
+	/**
+	 * print the memory held by the trees and the subtrees pruned to stay within mem=
+	 */
+	void report_memory(){
+		size_t used = 0, prunes = 0, nodes = 0, bytes = 0;
 		for(int i=0;i<parallel;i++){
-			trees[i]->advance_tree(trees[i]->root->Map_Action2Child[best_idx]);
+			used += trees[i]->memory;
+			prunes += trees[i]->prunes;
+			nodes += trees[i]->pruned_nodes;
+			bytes += trees[i]->pruned_bytes;
 		}
+		std::cerr << name() << ": tree " << (used >> 10) << "K/" << (memory << 10) << "K, "
+		          << prunes << " prunes, " << nodes << " subtrees (" << (bytes >> 10) << "K) recycled" << std::endl;
+	}
 
-		return move;
+	/**
+	 * search the positions handed out through the shared segment by the owner process,
+	 * and publish the root visits every few milliseconds, until the owner closes the segment
+	 */
+	void assist(const std::string& name){
+		shared_root seg(name, false);
+		int slot = seg.valid() ? seg.join() : -1;
+		if (slot < 0) return;
+		board b;
+		for (uint32_t seen = 0; !seg.closed(); ) {
+			uint32_t generation = seg.fetch(b);
+			if (generation == 0 || generation == seen) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			seen = generation;
+			if (mast) mast->decay(mast_decay);
+			MCTS_tree tree(new board(b), b.info().who_take_turns, max_time, RAVE);
+			tree.playout.cutoff = cutoff;
+			tree.playout.net = net.get();
+			tree.playout.patterns = patterns.get();
+			tree.playout.mast = mast.get();
+			tree.memory_limit = size_t(memory) * 1024 * 1024;
+			vector<int> visits(board::size_x*board::size_y);
+			while (seg.current() == generation && !tree.root->proven) {
+				tree.grow(64, 10000, p_earlystop);
+				for (int i = 0; i < int(visits.size()); i++) visits[i] = tree.get_simulation_cnt(i);
+				seg.report(slot, generation, visits.data());
+			}
+		}
 	}
 
 	int remainingtime(double sec, board b){
@@ -157,21 +398,49 @@ public:
 		return sec/(cnt+1);
 	}
 
-	void do_mcts(int i, board b){
-		MCTS_node* tmp = new MCTS_node(NULL, new board(b), NULL, who, who);
+	void do_mcts(int i, board b, int budget){
+		if(cpus.size()) topology::instance().pin(cpus[i % cpus.size()]);
+		MCTS_node* tmp = new MCTS_node(NULL, new board(b), placement(), who, who);
 		trees[i]->advance_tree(tmp);
-		trees[i]->max_time -= trees[i]->grow(max_iter, 10, p_earlystop);
+		trees[i]->grow(max_iter, budget, p_earlystop);
 	}
 
 private:
 	//MCTS_tree* tree = NULL;
 	vector<MCTS_tree*> trees;
 	string search_algo="random";
-	int max_iter=1500, parallel=1;
+	int max_iter=1500, parallel=1, cutoff=0;
+	int memory=0; // memory limit of the search trees in MB (0: unlimited)
+	int reuse=0;  // plies of the search trees kept across episodes (0: rebuilt every episode)
 	int max_time=40;
+	int max_depth=64;
+	double time_left=40;
+	double byoyomi=0;       // seconds of a byo-yomi period, from time_settings
+	int byoyomi_stones=0;   // moves to play in a byo-yomi period
+	int stones=0;           // moves left in the current byo-yomi period, 0 in the main time
+	bool clocked=false;     // whether a clock was set by time= or by the controller
+	double clock_base=-1;   // the first remaining time reported in this period, -1 if none
+	double clock_used=0;    // the thinking measured here since then
+	int clock_moves=0;      // the moves played since then
+	double latency=0.01;    // seconds per move charged by the controller beyond the thinking
 	double p_earlystop = 0.9;
-	std::vector<action::place> space;
+	int endgame=0, endgame_time=1000; // the endgame solver is off unless endgame= is given
+	uint64_t endgame_nodes=2000000;
+	endgame_solver solver;
+	alphabeta ab;
+	std::unique_ptr<evaluator> net;
+	std::unique_ptr<pattern_table> patterns; // 3x3 pattern weights of the playouts, by pattern or pattern=<file>
+	std::unique_ptr<mast_table> mast; // playout statistics of the moves, by mast or mast=<temperature>
+	double mast_decay=0.5; // the share of the statistics kept for the next move, 0 resets them
+	std::shared_ptr<shard_writer> recorder;
+	std::unique_ptr<opening_book> book;
+	std::unique_ptr<shared_root> shared; // root visits of the helper processes searching the same positions
+	std::vector<int> cpus; // the cpus the search threads are pinned to, by affinity=compact|scatter (empty: not pinned)
+	uint32_t book_min=10;
+	std::vector<record> pending;
+	std::vector<placement> space;
 	board::piece_type who;
 	bool RAVE=false;
+	bool halving=false; // sequential halving at the root, by root=halving (default root=uct)
 };
 
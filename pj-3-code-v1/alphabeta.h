@@ -0,0 +1,196 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * alphabeta.h: Alpha-beta search with iterative deepening and Lazy SMP
+ */
+
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * negamax alpha-beta search over bitboard positions
+ *
+ * the evaluation is the difference of the legal-move counts of both sides,
+ * moves are ordered by the transposition table move, two killers per ply and the history heuristic,
+ * helper threads run the same iterative deepening on a shared lockless transposition table (Lazy SMP)
+ */
+class alphabeta {
+public:
+	enum { win = 10000, infinity = 32000, max_ply = 96 };
+
+	struct result {
+		int move = -1;
+		int score = 0;
+		int depth = 0;
+		uint64_t nodes = 0;
+	};
+
+	alphabeta(unsigned tt_bits = 22) : table(size_t(1) << tt_bits), stop(false) {}
+
+	/**
+	 * search the position with iterative deepening until max_depth or the time budget is reached
+	 * the result of the main thread at its last completed depth is returned
+	 */
+	result search(const position& root, int max_depth, int budget_ms, int threads = 1) {
+		start = clock::now();
+		deadline = start + std::chrono::milliseconds(budget_ms);
+		budget = budget_ms;
+		stop = false;
+
+		std::vector<worker> workers(std::max(threads, 1));
+		std::vector<std::thread> helpers;
+		for (size_t i = 1; i < workers.size(); i++)
+			helpers.emplace_back(&alphabeta::deepen, this, std::ref(workers[i]), root, max_depth, int(i));
+		deepen(workers[0], root, max_depth, 0);
+		stop = true;
+		for (std::thread& t : helpers) t.join();
+
+		result res = workers[0].best;
+		for (const worker& w : workers) res.nodes += w.nodes;
+		return res;
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct worker {
+		int killer[max_ply][2];
+		int history[2][board::size_x * board::size_y];
+		uint64_t nodes = 0;
+		result best;
+		worker() {
+			std::fill(&killer[0][0], &killer[0][0] + max_ply * 2, -1);
+			std::fill(&history[0][0], &history[0][0] + 2 * board::size_x * board::size_y, 0);
+		}
+	};
+
+	/**
+	 * transposition table entry, the key is stored xor-ed with the data so that
+	 * an entry torn by concurrent writers is detected as a miss
+	 */
+	struct entry {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+	enum bound { exact = 0, lower = 1, upper = 2 };
+
+	static uint64_t pack(int score, int depth, int flag, int move) {
+		return uint64_t(uint16_t(int16_t(score))) | uint64_t(uint8_t(depth)) << 16 | uint64_t(flag) << 24 | uint64_t(uint8_t(move + 1)) << 32;
+	}
+	static int score_of(uint64_t d) { return int16_t(d & 0xffff); }
+	static int depth_of(uint64_t d) { return (d >> 16) & 0xff; }
+	static int flag_of(uint64_t d) { return (d >> 24) & 0xff; }
+	static int move_of(uint64_t d) { return int((d >> 32) & 0xff) - 1; }
+
+	bool probe(uint64_t key, uint64_t& d) const {
+		const entry& e = table[key & (table.size() - 1)];
+		d = e.data.load(std::memory_order_relaxed);
+		return (e.check.load(std::memory_order_relaxed) ^ d) == key;
+	}
+	void store(uint64_t key, int score, int depth, int flag, int move) {
+		entry& e = table[key & (table.size() - 1)];
+		uint64_t d = pack(score, depth, flag, move);
+		e.check.store(key ^ d, std::memory_order_relaxed);
+		e.data.store(d, std::memory_order_relaxed);
+	}
+
+	// proven wins are stored relative to the node so that they stay valid at other plies
+	static int to_table(int score, int ply) { return score > win - max_ply ? score + ply : score < -win + max_ply ? score - ply : score; }
+	static int from_table(int score, int ply) { return score > win - max_ply ? score - ply : score < -win + max_ply ? score + ply : score; }
+
+	void deepen(worker& w, position root, int max_depth, int id) {
+		for (int depth = 1 + (id & 1); depth <= max_depth && !stop; depth++) {
+			int best = -1;
+			int score = negamax(w, root, depth, -infinity, infinity, 0, &best);
+			if (stop && w.best.depth) break;
+			if (best == -1) break;
+			w.best.move = best;
+			w.best.score = score;
+			w.best.depth = depth;
+			if (std::abs(score) > win - max_ply) break; // solved
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+			if (id == 0 && elapsed * 2 > budget) break; // the next depth is unlikely to finish
+		}
+		if (id == 0) stop = true;
+	}
+
+	int evaluate(const position& p, const bitboard& moves) const {
+		return moves.count() - p.legal(position::other(p.turn)).count();
+	}
+
+	int negamax(worker& w, const position& p, int depth, int alpha, int beta, int ply, int* root_best = nullptr) {
+		if ((++w.nodes & 0x3ff) == 0 && clock::now() > deadline) stop = true;
+		if (stop) return 0;
+
+		bitboard moves = p.legal(p.turn);
+		if (!moves) return -win + ply;
+		if (depth <= 0 || ply >= max_ply) return evaluate(p, moves);
+
+		int tt_move = -1;
+		uint64_t d;
+		if (probe(p.key, d)) {
+			tt_move = move_of(d);
+			int score = from_table(score_of(d), ply);
+			if (!root_best && depth_of(d) >= depth) {
+				if (flag_of(d) == exact) return score;
+				if (flag_of(d) == lower && score >= beta) return score;
+				if (flag_of(d) == upper && score <= alpha) return score;
+			}
+		}
+
+		int list[board::size_x * board::size_y], order[board::size_x * board::size_y];
+		int n = 0;
+		int side = p.turn - 1;
+		while (moves) {
+			int mv = moves.pop();
+			int key = w.history[side][mv];
+			if (mv == w.killer[ply][1]) key += 1 << 28;
+			if (mv == w.killer[ply][0]) key += 1 << 29;
+			if (mv == tt_move) key += 1 << 30;
+			int k = n++;
+			for (; k > 0 && order[k - 1] < key; k--) {
+				order[k] = order[k - 1];
+				list[k] = list[k - 1];
+			}
+			order[k] = key;
+			list[k] = mv;
+		}
+
+		int alpha_orig = alpha, best = -infinity, best_move = list[0];
+		for (int i = 0; i < n; i++) {
+			position next = p;
+			next.play(list[i]);
+			int score = -negamax(w, next, depth - 1, -beta, -alpha, ply + 1);
+			if (stop) return 0;
+			if (score > best) {
+				best = score;
+				best_move = list[i];
+			}
+			if (score > alpha) alpha = score;
+			if (alpha >= beta) {
+				if (list[i] != w.killer[ply][0]) {
+					w.killer[ply][1] = w.killer[ply][0];
+					w.killer[ply][0] = list[i];
+				}
+				w.history[side][list[i]] = std::min(w.history[side][list[i]] + depth * depth, 1 << 27);
+				break;
+			}
+		}
+
+		int flag = best <= alpha_orig ? upper : best >= beta ? lower : exact;
+		store(p.key, to_table(best, ply), depth, flag, best_move);
+		if (root_best) *root_best = best_move;
+		return best;
+	}
+
+private:
+	std::vector<entry> table;
+	std::atomic<bool> stop;
+	clock::time_point start, deadline;
+	long budget;
+};
@@ -0,0 +1,214 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bench.h: Benchmarks of the search
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <sys/resource.h>
+#include "board.h"
+#include "action.h"
+#include "MCTS.h"
+#include "topology.h"
+
+class benchmark {
+public:
+	/**
+	 * the positions searched by the benchmarks: the empty board, and positions after
+	 * 10, 20 and 30 random moves of a fixed seed
+	 */
+	static std::vector<board> positions() {
+		std::vector<board> list(1);
+		std::default_random_engine gen(20221101);
+		board b;
+		for (int step = 1; step <= 30; step++) {
+			std::vector<int> legal;
+			for (int i = 0; i < board::size_x * board::size_y; i++) {
+				if (b.check(board::point(i)) == board::legal) legal.push_back(i);
+			}
+			if (legal.empty()) break;
+			b.place(board::point(legal[gen() % legal.size()]));
+			if (step % 10 == 0) list.push_back(b);
+		}
+		return list;
+	}
+
+	/**
+	 * measure the playouts per second of root-parallel MCTS with 1, 2, 4, ... max_threads threads,
+	 * each thread growing its own trees on all positions for ms milliseconds in total,
+	 * with the threads pinned by the given affinity (compact, scatter, or none)
+	 */
+	static void scaling(int max_threads, int ms, const std::string& affinity, std::ostream& out = std::cout) {
+		std::vector<int> cpus = topology::instance().order(affinity);
+		std::vector<board> list = positions();
+		out << "threads\tplayouts/s\tspeedup\tefficiency" << std::endl;
+		std::vector<int> steps;
+		for (int t = 1; t < max_threads; t *= 2) steps.push_back(t);
+		steps.push_back(std::max(max_threads, 1));
+		double base = 0;
+		for (int threads : steps) {
+			std::vector<uint64_t> count(threads, 0);
+			std::vector<std::thread> workers;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < threads; i++) {
+				workers.emplace_back([&, i] {
+					if (cpus.size()) topology::instance().pin(cpus[i % cpus.size()]);
+					for (size_t k = 0; k < list.size(); k++) {
+						auto until = start + std::chrono::milliseconds(ms * (k + 1) / list.size());
+						MCTS_tree tree(new board(list[k]), list[k].info().who_take_turns, 0, false);
+						while (std::chrono::steady_clock::now() < until && !tree.root->proven) tree.grow(16, ms, 0);
+						count[i] += tree.playout.playouts;
+					}
+				});
+			}
+			for (std::thread& t : workers) t.join();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			uint64_t total = 0;
+			for (uint64_t c : count) total += c;
+			double rate = total / seconds;
+			if (threads == 1) base = rate;
+			out << threads << "\t" << std::fixed << std::setprecision(0) << rate << "\t"
+			    << std::setprecision(2) << rate / base << "\t" << rate / base / threads << std::endl;
+		}
+		out.unsetf(std::ios::fixed);
+	}
+
+	/**
+	 * the deterministic benchmark: each of the threads grows its own tree on every position
+	 * for a fixed number of iterations, with a seed fixed per position and thread, and without
+	 * any time limit; the move of a position is the most visited one over the threads
+	 * the rates count the iterations grow actually ran (it stops once the root is proven),
+	 * and the playouts simulate actually ran (none for a terminal leaf)
+	 *
+	 * the suite runs twice, the moves of both runs must be identical, and the rates of the faster run
+	 * are reported as JSON (and written to output, if given) with the peak RSS of the process;
+	 * if a baseline written by an earlier run is given, a rate lower or a peak RSS higher than
+	 * the baseline by more than the tolerance is a regression, and so are moves different from
+	 * those of the baseline, unless accept_moves is set (e.g., to adopt a changed search);
+	 * a baseline missing any metric, or run with other threads or iterations, is not compared
+	 *
+	 * return 0 if the moves are deterministic and nothing regressed, or 1
+	 */
+	static int bench(int threads, const std::string& output, const std::string& baseline, double tolerance,
+			bool accept_moves = false, std::ostream& out = std::cout) {
+		enum { iterations = 10000, runs = 2 };
+		std::vector<board> list = positions();
+		threads = std::max(threads, 1);
+		std::string moves[runs];
+		double seconds = 0;
+		uint64_t iterated = 0, playouts = 0;
+		for (int r = 0; r < runs; r++) {
+			uint64_t iterated_run = 0, playouts_run = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (size_t k = 0; k < list.size(); k++) {
+				std::vector<std::vector<int>> visits(threads, std::vector<int>(board::size_x * board::size_y));
+				std::vector<uint64_t> iterated_by(threads), playouts_by(threads);
+				std::vector<std::thread> workers;
+				for (int i = 0; i < threads; i++) {
+					workers.emplace_back([&, i] {
+						random_engine().seed(unsigned(20221101 + k * 1000 + i));
+						MCTS_tree tree(new board(list[k]), list[k].info().who_take_turns, 0, false);
+						tree.grow(iterations, 1 << 30, 0);
+						for (int j = 0; j < board::size_x * board::size_y; j++) visits[i][j] = tree.get_simulation_cnt(j);
+						iterated_by[i] = tree.iterations; // fewer than the iterations if the root is proven
+						playouts_by[i] = tree.playout.playouts;
+					});
+				}
+				for (std::thread& t : workers) t.join();
+				int best = -1, best_cnt = 0;
+				for (int j = 0; j < board::size_x * board::size_y; j++) {
+					int cnt = 0;
+					for (int i = 0; i < threads; i++) cnt += visits[i][j];
+					if (cnt > best_cnt) best = j, best_cnt = cnt;
+				}
+				for (int i = 0; i < threads; i++) iterated_run += iterated_by[i], playouts_run += playouts_by[i];
+				moves[r] += (k ? " " : "") + std::string(board::point(best));
+			}
+			double used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (r == 0 || used < seconds) seconds = used, iterated = iterated_run, playouts = playouts_run;
+		}
+		bool deterministic = moves[0] == moves[1];
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+
+		std::stringstream json;
+		json << std::fixed << std::setprecision(1) << "{" << std::endl
+		     << "  \"positions\": " << list.size() << "," << std::endl
+		     << "  \"threads\": " << threads << "," << std::endl
+		     << "  \"iterations\": " << int(iterations) << "," << std::endl
+		     << "  \"moves\": \"" << moves[0] << "\"," << std::endl
+		     << "  \"deterministic\": " << (deterministic ? "true" : "false") << "," << std::endl
+		     << "  \"seconds\": " << std::setprecision(3) << seconds << "," << std::endl
+		     << "  \"iterations_per_second\": " << std::setprecision(1) << iterated / seconds << "," << std::endl
+		     << "  \"playouts_per_second\": " << playouts / seconds << "," << std::endl
+		     << "  \"peak_rss_kb\": " << usage.ru_maxrss << std::endl
+		     << "}" << std::endl;
+		out << json.str();
+		if (output.size() && output != "-") std::ofstream(output, std::ios::out | std::ios::trunc) << json.str();
+
+		int failed = 0;
+		if (!deterministic) {
+			out << "bench: the moves differ between runs: " << moves[1] << std::endl;
+			failed++;
+		}
+		if (baseline.size()) {
+			std::ifstream in(baseline);
+			std::string base((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			if (base.empty()) {
+				out << "bench: cannot read the baseline " << baseline << std::endl;
+				return 1;
+			}
+			const char* keys[] = { "threads", "iterations", "iterations_per_second", "playouts_per_second", "peak_rss_kb" };
+			bool complete = base.find("\"moves\": \"") != std::string::npos;
+			if (!complete) out << "bench: the baseline has no moves" << std::endl;
+			for (const char* key : keys) {
+				if (!std::isnan(number(base, key))) continue;
+				out << "bench: the baseline has no " << key << std::endl;
+				complete = false;
+			}
+			if (!complete) return 1;
+			if (number(base, "threads") != threads || number(base, "iterations") != iterations) {
+				out << "bench: the baseline was run with " << number(base, "threads") << " threads and " << number(base, "iterations")
+				    << " iterations, not " << threads << " and " << int(iterations) << std::endl;
+				return 1;
+			}
+			const char* higher_is_better[] = { "iterations_per_second", "playouts_per_second" };
+			for (const char* key : higher_is_better) {
+				double was = number(base, key), now = number(json.str(), key);
+				if (now < was * (1 - tolerance)) {
+					out << "bench: " << key << " regressed from " << was << " to " << now << std::endl;
+					failed++;
+				}
+			}
+			double was = number(base, "peak_rss_kb"), now = number(json.str(), "peak_rss_kb");
+			if (now > was * (1 + tolerance)) {
+				out << "bench: peak_rss_kb regressed from " << was << " to " << now << std::endl;
+				failed++;
+			}
+			if (base.find("\"moves\": \"" + moves[0] + "\"") == std::string::npos) {
+				out << "bench: the moves differ from the baseline" << (accept_moves ? ", accepted" : "") << std::endl;
+				if (!accept_moves) failed++;
+			}
+		}
+		out.unsetf(std::ios::fixed);
+		return failed ? 1 : 0;
+	}
+
+private:
+	/**
+	 * the number of a key in the flat JSON written by bench(), or NAN if it is missing
+	 */
+	static double number(const std::string& json, const std::string& key) {
+		size_t at = json.find("\"" + key + "\":");
+		if (at == std::string::npos) return NAN;
+		return std::strtod(json.c_str() + at + key.size() + 3, nullptr);
+	}
+};
@@ -0,0 +1,143 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bitboard.h: Bitboard position and legal-move generation for the search algorithms
+ */
+
+#pragma once
+#include <cstdint>
+#include "board.h"
+
+/**
+ * set of board points stored in two 64-bit words
+ * bit i corresponds to board::point(i), i.e., i = x * size_y + y
+ */
+struct bitboard {
+	uint64_t lo, hi;
+	constexpr bitboard(uint64_t lo = 0, uint64_t hi = 0) : lo(lo), hi(hi) {}
+
+	static bitboard bit(int i) { return i < 64 ? bitboard(1ull << i, 0) : bitboard(0, 1ull << (i - 64)); }
+	static bitboard all() { return bitboard(~0ull, (1ull << (board::size_x * board::size_y - 64)) - 1); }
+
+	bool test(int i) const { return i < 64 ? (lo >> i) & 1 : (hi >> (i - 64)) & 1; }
+	bool empty() const { return !(lo | hi); }
+	explicit operator bool() const { return lo | hi; }
+	int count() const { return __builtin_popcountll(lo) + __builtin_popcountll(hi); }
+	int first() const { return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(hi); }
+	int pop() { int i = first(); if (lo) lo &= lo - 1; else hi &= hi - 1; return i; }
+
+	bitboard operator |(const bitboard& b) const { return bitboard(lo | b.lo, hi | b.hi); }
+	bitboard operator &(const bitboard& b) const { return bitboard(lo & b.lo, hi & b.hi); }
+	bitboard operator ^(const bitboard& b) const { return bitboard(lo ^ b.lo, hi ^ b.hi); }
+	bitboard operator ~() const { return bitboard(~lo, ~hi) & all(); }
+	bitboard& operator |=(const bitboard& b) { lo |= b.lo; hi |= b.hi; return *this; }
+	bitboard& operator &=(const bitboard& b) { lo &= b.lo; hi &= b.hi; return *this; }
+	bitboard& operator ^=(const bitboard& b) { lo ^= b.lo; hi ^= b.hi; return *this; }
+	bool operator ==(const bitboard& b) const { return lo == b.lo && hi == b.hi; }
+	bool operator !=(const bitboard& b) const { return !(*this == b); }
+
+	bitboard operator <<(int n) const { return bitboard(lo << n, (hi << n) | (lo >> (64 - n))) & all(); } // 0 < n < 64
+	bitboard operator >>(int n) const { return bitboard((lo >> n) | (hi << (64 - n)), hi >> n); } // 0 < n < 64
+
+	/**
+	 * the points orthogonally adjacent to any point of this set (may overlap the set itself)
+	 * note that hollow points are not excluded here, mask the result with position::playable()
+	 */
+	bitboard adjacent() const {
+		static const bitboard bottom = row(0), top = row(board::size_y - 1);
+		return ((*this & ~top) << 1) | ((*this & ~bottom) >> 1) | (*this << board::size_y) | (*this >> board::size_y);
+	}
+	static bitboard row(int y) {
+		bitboard b;
+		for (int x = 0; x < board::size_x; x++) b |= bit(x * board::size_y + y);
+		return b;
+	}
+};
+
+/**
+ * compact NoGo position for search, copy-make is cheap (5 words)
+ */
+class position {
+public:
+	position() : stone{bitboard(), bitboard()}, turn(board::black), key(zobrist(board::black)) {}
+	position(const board& b) : stone{bitboard(), bitboard()}, turn(b.info().who_take_turns), key(zobrist(turn)) {
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board::cell c = b(i);
+			if (c == board::black || c == board::white) {
+				stone[c - 1] |= bitboard::bit(i);
+				key ^= zobrist(i, c);
+			}
+		}
+	}
+
+public:
+	static board::piece_type other(unsigned who) { return static_cast<board::piece_type>(3u - who); }
+
+	/**
+	 * the points that can hold a stone, i.e., all points except the hollow ones
+	 */
+	static const bitboard& playable() {
+		static const bitboard mask = [] {
+			board b;
+			bitboard m;
+			for (int i = 0; i < board::size_x * board::size_y; i++)
+				if (b(i) == board::empty) m |= bitboard::bit(i);
+			return m;
+		}();
+		return mask;
+	}
+
+	bitboard stones(unsigned who) const { return stone[who - 1]; }
+	bitboard empty() const { return playable() & ~(stone[0] | stone[1]); }
+
+	/**
+	 * the connected block of stones containing point i
+	 */
+	bitboard block(int i) const {
+		bitboard own = stone[0].test(i) ? stone[0] : stone[1];
+		bitboard g = bitboard::bit(i);
+		for (bitboard n = (g.adjacent() | g) & own; n != g; n = (g.adjacent() | g) & own) g = n;
+		return g;
+	}
+
+	/**
+	 * the legal moves of a side, following the rules of board::place
+	 * a point is illegal if it is the last liberty of an opponent block (take),
+	 * or if it has no empty neighbor and no adjacent own block with another liberty (suicide)
+	 */
+	bitboard legal(unsigned who) const {
+		bitboard emp = empty();
+		bitboard strong, take;
+		for (unsigned c = board::black; c <= board::white; c++) {
+			for (bitboard rest = stone[c - 1]; rest; ) {
+				bitboard g = block(rest.first());
+				rest &= ~g;
+				bitboard lib = g.adjacent() & emp;
+				if (lib.count() >= 2) {
+					if (c == who) strong |= g;
+				} else if (c != who) {
+					take |= lib;
+				}
+			}
+		}
+		bitboard breath = (emp.adjacent() | strong.adjacent()) & emp;
+		return breath & ~take;
+	}
+
+	/**
+	 * place a stone of the side to move at point i, the move must be legal
+	 */
+	void play(int i) {
+		stone[turn - 1] |= bitboard::bit(i);
+		key ^= zobrist(i, turn) ^ zobrist(turn) ^ zobrist(other(turn));
+		turn = other(turn);
+	}
+
+public:
+	static uint64_t zobrist(int i, unsigned who) { return board::zobrist(i, who); }
+	static uint64_t zobrist(unsigned turn) { return board::zobrist(turn); }
+
+public:
+	bitboard stone[2];
+	board::piece_type turn;
+	uint64_t key;
+};
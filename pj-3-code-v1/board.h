@@ -15,6 +15,9 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <cstdint>
+#include <random>
+#include "profile.h"
 
 /**
  * definition for the 9x9 board
@@ -56,14 +59,14 @@ public:
 	typedef int reward;
 
 public:
-	board() : stone(initial()), attr({piece_type::black}) {}
-	board(const grid& b, const data& d) : stone(b), attr(d) {}
+	board() : stone(initial()), attr({piece_type::black}), key(0), patterns(initial_patterns()), depth(0) {}
+	board(const grid& b, const data& d) : stone(b), attr(d) { rehash(); }
 	board(const board& b) = default;
 	board& operator =(const board& b) = default;
 
 	struct point {
 		int x, y, i;
-		point(int i = -1) : x(i != -1 ? i / size_y : -1), y(i != -1 ? i % size_y : -1), i(i) {}
+		point(int i = -1) : x(i != -1 ? x_of(i) : -1), y(i != -1 ? y_of(i) : -1), i(i) {}
 		point(int x, int y) : x(x), y(y), i(x != -1 && y != -1 ? x * size_y + y : -1) {}
 		point(const std::string& name) : point(
 			name.size() >= 2 && name != "PASS" ? name[0] - (name[0] > 'I' ? 'B' : 'A') : -1,
@@ -87,7 +90,37 @@ public:
 	const cell& operator ()(const std::string& move) const { point p(move); return stone[p.x][p.y]; }
 	
 	data info() const { return attr; }
-	data info(data dat) { data old = attr; attr = dat; return old; }
+	data info(data dat) {
+		data old = attr;
+		attr = dat;
+		key ^= zobrist(old.who_take_turns) ^ zobrist(dat.who_take_turns);
+		return old;
+	}
+
+	/**
+	 * Zobrist hash of the stones and the side to move, kept up to date by place, play and undo
+	 * cells written directly through the accessors above need a rehash() afterwards
+	 */
+	uint64_t hash() const { return key; }
+	void rehash() {
+		key = zobrist(attr.who_take_turns);
+		for (int i = 0; i < size_x * size_y; i++) {
+			cell c = stone[i / size_y][i % size_y];
+			if (c == piece_type::black || c == piece_type::white) key ^= zobrist(i, c);
+		}
+		patterns = surroundings(stone);
+		depth = 0; // the recorded moves may no longer match the stones
+	}
+
+	/**
+	 * the 3x3 pattern code of point i, i.e., the 8 points around it in 2 bits each
+	 * (empty, black, white, or 3 for hollow and outside the board), clockwise from [x-1][y-1]
+	 * with the orthogonal neighbors at the odd positions; kept up to date as the hash
+	 */
+	uint16_t pattern(int i) const { return patterns[i]; }
+
+	static uint64_t zobrist(int i, unsigned who) { return zobrist_table()[i * 2 + (who - 1)]; }
+	static uint64_t zobrist(unsigned turn) { return turn == piece_type::white ? zobrist_table()[size_x * size_y * 2] : 0; }
 
 public:
 	bool operator ==(const board& b) const { return stone == b.stone; }
@@ -138,70 +171,138 @@ public:
 	 * return nogo_move_result::legal if the action is valid, or nogo_move_result::illegal_* if not
 	 */
 	reward place(int x, int y, unsigned who = piece_type::unknown) {
+		NOGO_PROFILE_SCOPE(place);
+		reward result = check(x, y, who);
+		if (result == nogo_move_result::legal) play(point(x, y)); // is legal move!
+		return result;
+	}
+	reward place(const point& p, unsigned who = piece_type::unknown) {
+		return place(p.x, p.y, who);
+	}
+
+	/**
+	 * the result place() would return, without changing the board
+	 */
+	reward check(int x, int y, unsigned who = piece_type::unknown) const {
+		NOGO_PROFILE_SCOPE(check);
 		if (who == -1u) who = attr.who_take_turns;
 		if (who != attr.who_take_turns) return nogo_move_result::illegal_turn;
 		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
 		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
 		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
 		if (board::initial()[x][y] == piece_type::hollow)             return nogo_move_result::illegal_out_of_range;
-		board test = *this;
-		if (test[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
-		test[x][y] = who; // try put a piece first
-		if (test.check_liberty(x, y, who) == 0) return nogo_move_result::illegal_suicide;
+		if (stone[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
+		int skip = x * size_y + y; // the point is filled by the new piece
 		unsigned opp = 3u - who;
-		if (x > p_min.x && test.check_liberty(x - 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (x < p_max.x && test.check_liberty(x + 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (y > p_min.y && test.check_liberty(x, y - 1, opp) == 0) return nogo_move_result::illegal_take;
-		if (y < p_max.y && test.check_liberty(x, y + 1, opp) == 0) return nogo_move_result::illegal_take;
-		stone[x][y] = who; // is legal move!
-		attr.who_take_turns = static_cast<piece_type>(opp);
+		bool liberty = false;
+		for (int k = 0; k < 4 && !liberty; k++) {
+			int j = neighbor(x, y, k);
+			if (j == -1) continue;
+			cell c = stone[x_of(j)][y_of(j)];
+			liberty = c == piece_type::empty || (c == who && breathes(x_of(j), y_of(j), skip));
+		}
+		if (!liberty) return nogo_move_result::illegal_suicide;
+		for (int k = 0; k < 4; k++) {
+			int j = neighbor(x, y, k);
+			if (j == -1) continue;
+			if (stone[x_of(j)][y_of(j)] == opp && !breathes(x_of(j), y_of(j), skip)) return nogo_move_result::illegal_take;
+		}
 		return nogo_move_result::legal;
 	}
-	reward place(const point& p, unsigned who = piece_type::unknown) {
-		return place(p.x, p.y, who);
+	reward check(const point& p, unsigned who = piece_type::unknown) const {
+		return check(p.x, p.y, who);
 	}
 
+	/**
+	 * place a stone of the side to move in place, without checking, i.e., the move must be legal
+	 * the move is recorded on the undo stack, which holds enough moves to fill the board
+	 */
+	void play(const point& p) {
+		unsigned who = attr.who_take_turns;
+		stone[p.x][p.y] = who;
+		key ^= zobrist(p.i, who) ^ zobrist(who) ^ zobrist(3u - who);
+		for (int k = 0; k < 8; k++) {
+			int j = around(p.i, k);
+			if (j != -1) patterns[j] |= who << ((k ^ 4) * 2); // p is in the opposite direction from j
+		}
+		attr.who_take_turns = static_cast<piece_type>(3u - who);
+		history[depth++] = p.i;
+	}
+
+	/**
+	 * take back the last move placed or played, the side that played it is to move again
+	 */
+	void undo() {
+		point p(history[--depth]);
+		unsigned who = stone[p.x][p.y];
+		stone[p.x][p.y] = piece_type::empty;
+		key ^= zobrist(p.i, who) ^ zobrist(who) ^ zobrist(3u - who);
+		for (int k = 0; k < 8; k++) {
+			int j = around(p.i, k);
+			if (j != -1) patterns[j] &= ~(3u << ((k ^ 4) * 2));
+		}
+		attr.who_take_turns = static_cast<piece_type>(who);
+	}
+
+	/**
+	 * the number of moves that can be undone
+	 */
+	int moves() const { return depth; }
+
 	/**
 	 * calculate the liberty of the block of piece at [x][y]
 	 * return >= 0 if [x][y] is placed by who; otherwise return -1
 	 */
 	int check_liberty(int x, int y, unsigned who) const {
-		grid test = stone;
-		if (test[x][y] != who) return -1;
-		
-		int liberty = 0;
-		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
-			int x = check.front().x, y = check.front().y;
-			test[x][y] = piece_type::unknown; // prevent recalculate
-
-			point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-
-			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
-			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
-
-			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
-			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
-
-			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
-			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
-
-			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
-			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
+		NOGO_PROFILE_SCOPE(liberty);
+		if (stone[x][y] != who) return -1;
+		bool seen[size_x * size_y] = {};
+		int check[size_x * size_y], n = 0, liberty = 0;
+		seen[x * size_y + y] = true;
+		for (check[n++] = x * size_y + y; n; ) {
+			int i = check[--n];
+			for (int k = 0; k < 4; k++) {
+				int j = neighbor(x_of(i), y_of(i), k);
+				if (j == -1 || seen[j]) continue;
+				cell c = stone[x_of(j)][y_of(j)];
+				if (c == piece_type::empty) { seen[j] = true; liberty++; }
+				else if (c == who) { seen[j] = true; check[n++] = j; }
+			}
 		}
 		return liberty;
 	}
 
+	/**
+	 * whether the block of piece at [x][y] has a liberty other than point skip,
+	 * the flood fill stops at the first liberty found
+	 */
+	bool breathes(int x, int y, int skip) const {
+		NOGO_PROFILE_SCOPE(liberty);
+		unsigned who = stone[x][y];
+		bool seen[size_x * size_y] = {};
+		int check[size_x * size_y], n = 0;
+		seen[x * size_y + y] = true;
+		for (check[n++] = x * size_y + y; n; ) {
+			int i = check[--n];
+			for (int k = 0; k < 4; k++) {
+				int j = neighbor(x_of(i), y_of(i), k);
+				if (j == -1 || seen[j]) continue;
+				seen[j] = true;
+				cell c = stone[x_of(j)][y_of(j)];
+				if (c == piece_type::empty && j != skip) return true;
+				if (c == who) check[n++] = j;
+			}
+		}
+		return false;
+	}
+
 	void transpose() {
 		for (int x = 0; x < size_x; x++) {
 			for (int y = x + 1; y < size_y; y++) {
 				std::swap(stone[x][y], stone[y][x]);
 			}
 		}
+		rehash();
 	}
 
 	void reflect_horizontal() {
@@ -210,6 +311,7 @@ public:
 				std::swap(stone[x][y], stone[size_x - 1 - x][y]);
 			}
 		}
+		rehash();
 	}
 
 	void reflect_vertical() {
@@ -218,6 +320,7 @@ public:
 				std::swap(stone[x][y], stone[x][size_y - 1 - y]);
 			}
 		}
+		rehash();
 	}
 
 	/**
@@ -286,6 +389,7 @@ public:
 			}
 		}
 		for (int x = 0; x < size_x; x++) in >> token; /* skip X */
+		b.rehash();
 		return in;
 	}
 	friend std::ostream& operator <<(std::ostream& out, const point& p) {
@@ -298,6 +402,64 @@ public:
 	}
 
 protected:
+	/**
+	 * the k-th neighbor (left, right, down, up) of [x][y], or -1 if it is outside the board
+	 */
+	static int neighbor(int x, int y, int k) {
+		static const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+		int nx = x + dx[k], ny = y + dy[k];
+		return nx >= 0 && nx < size_x && ny >= 0 && ny < size_y ? nx * size_y + ny : -1;
+	}
+
+	static const uint64_t* zobrist_table() {
+		static const std::array<uint64_t, size_x * size_y * 2 + 1> keys = [] {
+			std::mt19937_64 gen(0x9e3779b97f4a7c15ull);
+			std::array<uint64_t, size_x * size_y * 2 + 1> k;
+			for (uint64_t& v : k) v = gen();
+			return k;
+		}();
+		return keys.data();
+	}
+
+	/**
+	 * the coordinates [x][y] of the 1-d index i, looked up in a table rather than divided
+	 */
+	static int x_of(int i) { return unsigned(i) < size_x * size_y ? coordinates().x[i] : i / size_y; }
+	static int y_of(int i) { return unsigned(i) < size_x * size_y ? coordinates().y[i] : i % size_y; }
+	/**
+	 * the k-th point of the 3x3 ring around point i, in the order of pattern(), or -1 if it is outside the board
+	 */
+	static int around(int i, int k) { return coordinates().ring[i][k]; }
+	struct coordinate_table { uint8_t x[size_x * size_y], y[size_x * size_y]; int8_t ring[size_x * size_y][8]; };
+	static const coordinate_table& coordinates() { static coordinate_table table; return table; }
+	static __attribute__((constructor)) void init_coordinates() {
+		coordinate_table& table = const_cast<coordinate_table&>(coordinates());
+		static const int dx[] = { -1, -1, -1, 0, 1, 1, 1, 0 }, dy[] = { -1, 0, 1, 1, 1, 0, -1, -1 };
+		for (int i = 0; i < size_x * size_y; i++) {
+			table.x[i] = i / size_y;
+			table.y[i] = i % size_y;
+			for (int k = 0; k < 8; k++) {
+				int nx = table.x[i] + dx[k], ny = table.y[i] + dy[k];
+				table.ring[i][k] = nx >= 0 && nx < size_x && ny >= 0 && ny < size_y ? nx * size_y + ny : -1;
+			}
+		}
+	}
+
+	typedef std::array<uint16_t, size_x * size_y> pattern_codes;
+	static pattern_codes surroundings(const grid& stone) {
+		pattern_codes codes;
+		for (int i = 0; i < size_x * size_y; i++) {
+			codes[i] = 0;
+			for (int k = 0; k < 8; k++) {
+				int j = around(i, k);
+				unsigned c = j != -1 ? stone[x_of(j)][y_of(j)] : unsigned(piece_type::hollow);
+				codes[i] |= std::min(c, 3u) << (k * 2);
+			}
+		}
+		return codes;
+	}
+	static const pattern_codes& initial_patterns() { static const pattern_codes codes = surroundings(initial()); return codes; }
+
 	static const grid& initial() { static grid stone; return stone; }
 	static __attribute__((constructor)) void init_initial_scheme() {
 		grid& stone = const_cast<grid&>(initial());
@@ -313,4 +475,8 @@ protected:
 private:
 	grid stone;
 	data attr;
+	uint64_t key;
+	pattern_codes patterns; // the 3x3 pattern code of every point
+	std::array<uint8_t, size_x * size_y> history; // the points of the moves that can be undone
+	int depth;
 };
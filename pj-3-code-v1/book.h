@@ -0,0 +1,150 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * book.h: Memory-mapped opening book keyed by canonical position hashes
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * the book is a 16-byte header ("NOGOBK01", uint64 entry count) followed by
+ * the entries sorted by (key, move), hence it is looked up in place by binary search
+ *
+ * positions are reduced by the 8 symmetries of the board (the hollow points are symmetric too),
+ * both the key and the move of an entry are given in the canonical orientation
+ */
+class opening_book {
+public:
+	struct entry {
+		uint64_t key;    // canonical position hash
+		uint32_t visits; // times the move was played from the position
+		uint32_t wins;   // times the side to move won after the move
+		uint16_t move;   // canonical move
+		uint16_t reserved[3];
+	};
+
+	opening_book(const std::string& path) : base(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && size_t(st.st_size) >= 16) {
+			void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (addr != MAP_FAILED) {
+				base = static_cast<const char*>(addr);
+				length = st.st_size;
+			}
+		}
+		::close(fd);
+		if (base && std::memcmp(base, "NOGOBK01", 8) != 0) {
+			munmap(const_cast<char*>(base), length);
+			base = nullptr;
+		}
+	}
+	~opening_book() { if (base) munmap(const_cast<char*>(base), length); }
+	opening_book(const opening_book&) = delete;
+	opening_book& operator =(const opening_book&) = delete;
+
+	bool valid() const { return base; }
+	size_t size() const { return base ? std::min<size_t>(*reinterpret_cast<const uint64_t*>(base + 8), (length - 16) / sizeof(entry)) : 0; }
+
+	/**
+	 * return the move played most often from the position, or -1 if the position
+	 * is not in the book or the move was played fewer than min_visits times
+	 */
+	int lookup(const board& b, uint32_t min_visits = 1) const {
+		int sym;
+		uint64_t key = canonical(b, sym);
+		const entry* begin = reinterpret_cast<const entry*>(base + 16);
+		const entry* end = begin + size();
+		const entry* it = std::lower_bound(begin, end, key, [](const entry& e, uint64_t k) { return e.key < k; });
+		const entry* best = nullptr;
+		for (; it != end && it->key == key; it++) {
+			if (it->visits >= min_visits && (!best || it->visits > best->visits)) best = it;
+		}
+		return best ? inverse(best->move, sym) : -1;
+	}
+
+public:
+	/**
+	 * map point i by symmetry sym: bit 2 transposes, bit 0 reflects x, bit 1 reflects y
+	 */
+	static int transform(int i, int sym) {
+		int x = i / board::size_y, y = i % board::size_y;
+		if (sym & 4) std::swap(x, y);
+		if (sym & 1) x = board::size_x - 1 - x;
+		if (sym & 2) y = board::size_y - 1 - y;
+		return x * board::size_y + y;
+	}
+	static int inverse(int i, int sym) {
+		int x = i / board::size_y, y = i % board::size_y;
+		if (sym & 1) x = board::size_x - 1 - x;
+		if (sym & 2) y = board::size_y - 1 - y;
+		if (sym & 4) std::swap(x, y);
+		return x * board::size_y + y;
+	}
+
+	/**
+	 * the smallest hash over the symmetries of the board, sym is set to the symmetry that gives it
+	 */
+	static uint64_t canonical(const board& b, int& sym) {
+		uint64_t keys[8];
+		for (int s = 0; s < 8; s++) keys[s] = position::zobrist(b.info().who_take_turns);
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board::cell c = b(i);
+			if (c != board::black && c != board::white) continue;
+			for (int s = 0; s < 8; s++) keys[s] ^= position::zobrist(transform(i, s), c);
+		}
+		sym = std::min_element(keys, keys + 8) - keys;
+		return keys[sym];
+	}
+
+	/**
+	 * accumulate the statistics of played moves and write them as a book file
+	 */
+	class builder {
+	public:
+		void add(const board& b, int move, bool win) {
+			int sym;
+			uint64_t key = canonical(b, sym);
+			auto& stat = stats[std::make_pair(key, transform(move, sym))];
+			stat.first++;
+			stat.second += win;
+		}
+
+		bool save(const std::string& path) const {
+			std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+			uint64_t count = stats.size();
+			out.write("NOGOBK01", 8);
+			out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			for (const auto& kv : stats) { // std::map iterates in (key, move) order
+				entry e;
+				std::memset(&e, 0, sizeof(e));
+				e.key = kv.first.first;
+				e.move = kv.first.second;
+				e.visits = kv.second.first;
+				e.wins = kv.second.second;
+				out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+			}
+			return bool(out);
+		}
+
+		size_t size() const { return stats.size(); }
+
+	private:
+		std::map<std::pair<uint64_t, int>, std::pair<uint32_t, uint32_t>> stats;
+	};
+
+private:
+	const char* base;
+	size_t length;
+};
@@ -0,0 +1,270 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * coordinator.h: Multi-process self-play over a Unix-domain socket
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+
+/**
+ * self-play coordinator, hands out the games of stats to the workers connected to the socket at path
+ * 'spawn' local workers are started as "nogo --connect=path", others may connect by themselves,
+ * the finished episodes are merged into stats as they arrive, and the games of workers
+ * that disconnect before finishing are reassigned
+ *
+ * the protocol is line-based text over a stream socket
+ *   coordinator -> worker: "config <black args>\t<white args>", "game <index> <seed>", "quit"
+ *   worker -> coordinator: "episode <index> <episode>", the episode in the format of --save
+ * a worker plays one game at a time, and may use several threads through parallel=
+ *
+ * the player options record= and shared= are rejected (see unsupported), since they name one shard
+ * prefix or shared segment per process
+ */
+class coordinator {
+public:
+	coordinator(const std::string& path, const std::string& black_args, const std::string& white_args)
+		: path(path), config("config " + black_args + "\t" + white_args), server(-1) {}
+	~coordinator() {
+		for (connection& c : conns) ::close(c.fd);
+		if (server >= 0) {
+			::close(server);
+			::unlink(path.c_str());
+		}
+		for (pid_t pid : children) waitpid(pid, nullptr, 0);
+	}
+	coordinator(const coordinator&) = delete;
+	coordinator& operator =(const coordinator&) = delete;
+
+	bool run(statistics& stats, size_t games, int spawn) {
+		std::signal(SIGPIPE, SIG_IGN);
+		server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		sockaddr_un addr = address(path);
+		::unlink(path.c_str());
+		if (server < 0 || ::bind(server, (sockaddr*) &addr, sizeof(addr)) != 0 || ::listen(server, 64) != 0) {
+			std::cerr << "coordinator: cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		for (int i = 0; i < spawn; i++) start_worker();
+
+		for (size_t i = stats.step(); i < games; i++) queue.push_back(i);
+		done.assign(games, false);
+		for (size_t left = queue.size(); left; ) {
+			for (size_t k = 0; k < children.size(); ) { // reap the local workers that exited
+				if (waitpid(children[k], nullptr, WNOHANG) == children[k]) children.erase(children.begin() + k);
+				else k++;
+			}
+			if (conns.empty() && children.empty() && spawn) {
+				std::cerr << "coordinator: no worker left, " << left << " games unfinished" << std::endl;
+				return false;
+			}
+
+			std::vector<pollfd> fds(1, pollfd{ server, POLLIN, 0 });
+			for (connection& c : conns) fds.push_back(pollfd{ c.fd, POLLIN, 0 });
+			if (poll(fds.data(), fds.size(), 1000) <= 0) continue;
+
+			for (size_t k = 1; k < fds.size(); k++) {
+				connection& c = conns[k - 1];
+				if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+				std::vector<std::string> lines;
+				bool alive = recv_lines(c.fd, c.buffer, lines);
+				for (const std::string& line : lines) {
+					std::stringstream ss(line);
+					std::string type;
+					long index;
+					if (!(ss >> type >> index) || type != "episode" || index < 0 || size_t(index) >= games) continue;
+					if (index == c.game) c.game = -1;
+					if (done[index]) continue; // a reassigned game finished twice
+					episode game;
+					ss >> game;
+					if (!ss) continue;
+					done[index] = true;
+					left--;
+					stats.add_episode(game);
+				}
+				if (!alive) { // the worker died, its game goes back to the queue
+					if (c.game != -1 && !done[c.game]) queue.push_front(c.game);
+					::close(c.fd);
+					c.fd = -1;
+				}
+			}
+			conns.erase(std::remove_if(conns.begin(), conns.end(), [](const connection& c) { return c.fd < 0; }), conns.end());
+
+			if (fds[0].revents & POLLIN) {
+				int fd = ::accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+				if (fd >= 0 && send_line(fd, config)) conns.push_back(connection{ fd, -1, "" });
+				else if (fd >= 0) ::close(fd);
+			}
+			for (connection& c : conns) if (c.game == -1) assign(c);
+		}
+		for (connection& c : conns) send_line(c.fd, "quit");
+		return true;
+	}
+
+	/**
+	 * the first player option of args that cannot be used with workers, or an empty string if none:
+	 * record= would make the workers overwrite the shards of each other (and record a reassigned game
+	 * again if its worker died after recording it), and shared= would make every worker own the same segment
+	 */
+	static std::string unsupported(const std::string& args) {
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			std::string key = pair.substr(0, pair.find('='));
+			if (key == "record" || key == "shared") return key;
+		}
+		return "";
+	}
+
+	/**
+	 * connect to the coordinator at path and play the games it hands out until it says quit,
+	 * the seed of each game is applied to the random engines of the search and of both players
+	 */
+	static bool worker(const std::string& path) {
+		std::signal(SIGPIPE, SIG_IGN);
+		int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		sockaddr_un addr = address(path);
+		if (fd < 0 || ::connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+			std::cerr << "worker: cannot connect to " << path << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		std::unique_ptr<player> black, white;
+		std::string buffer;
+		for (std::vector<std::string> lines; recv_lines(fd, buffer, lines); lines.clear()) {
+			for (const std::string& line : lines) {
+				std::stringstream ss(line);
+				std::string type;
+				ss >> type;
+				if (type == "config") {
+					std::string args = line.substr(line.find(' ') + 1);
+					black.reset(new player("name=black " + args.substr(0, args.find('\t')) + " role=black"));
+					white.reset(new player("name=white " + args.substr(args.find('\t') + 1) + " role=white"));
+				} else if (type == "game" && black && white) {
+					long index;
+					unsigned seed;
+					ss >> index >> seed;
+					seed_random_engines(seed);
+					black->seed(seed);
+					white->seed(seed ^ 0x5bd1e995u);
+					std::stringstream out;
+					out << "episode " << index << " " << play(*black, *white);
+					if (!send_line(fd, out.str())) break;
+				} else if (type == "quit") {
+					::close(fd);
+					return true;
+				}
+			}
+		}
+		::close(fd);
+		return false;
+	}
+
+private:
+	struct connection {
+		int fd;
+		long game; // the game being played, or -1
+		std::string buffer;
+	};
+
+	static episode play(player& black, player& white) {
+		episode game;
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+		game.open_episode(black.name() + ":" + white.name());
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (game.apply_action(move) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		agent& win = game.last_turns(black, white);
+		game.close_episode(win.name());
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+		return game;
+	}
+
+	void assign(connection& c) {
+		while (queue.size() && done[queue.front()]) queue.pop_front();
+		if (queue.empty()) return;
+		c.game = queue.front();
+		queue.pop_front();
+		unsigned seed = unsigned(c.game) * 2654435761u + 0x9e3779b9u; // distinct and well spread per game
+		if (!send_line(c.fd, "game " + std::to_string(c.game) + " " + std::to_string(seed))) {
+			queue.push_front(c.game);
+			c.game = -1;
+		}
+	}
+
+	void start_worker() {
+		std::string arg = "--connect=" + path;
+		pid_t pid = fork();
+		if (pid == 0) {
+			int null = ::open("/dev/null", O_WRONLY);
+			if (null >= 0) dup2(null, 1); // the banner of the worker
+			execl("/proc/self/exe", "nogo", arg.c_str(), (char*) nullptr);
+			_exit(127);
+		}
+		if (pid > 0) children.push_back(pid);
+	}
+
+	static bool send_line(int fd, const std::string& line) {
+		std::string data = line + "\n";
+		for (size_t sent = 0; sent < data.size(); ) {
+			ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			sent += n;
+		}
+		return true;
+	}
+
+	/**
+	 * read more data into buffer and pop the complete lines, return false on EOF or error
+	 */
+	static bool recv_lines(int fd, std::string& buffer, std::vector<std::string>& lines) {
+		char chunk[65536];
+		ssize_t n = ::read(fd, chunk, sizeof(chunk));
+		if (n < 0 && errno == EINTR) return true;
+		if (n <= 0) return false;
+		buffer.append(chunk, n);
+		for (size_t eol; (eol = buffer.find('\n')) != std::string::npos; buffer.erase(0, eol + 1))
+			lines.push_back(buffer.substr(0, eol));
+		return true;
+	}
+
+	static sockaddr_un address(const std::string& path) {
+		sockaddr_un addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		return addr;
+	}
+
+private:
+	std::string path;
+	std::string config;
+	int server;
+	std::vector<connection> conns;
+	std::deque<size_t> queue;
+	std::vector<bool> done;
+	std::vector<pid_t> children;
+};
@@ -0,0 +1,302 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * differential.h: Reference rules of NoGo, and differential validation of the optimized board kernels
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <iostream>
+#include "board.h"
+#include "bitboard.h"
+#include "action.h"
+#include "MCTS.h"
+
+/**
+ * the rules of NoGo as originally written for board::place, kept simple rather than fast:
+ * the move is tried on a copy of the board, and the liberties are counted by a flood fill
+ * the hash is computed from scratch, and undo restores a saved copy of the board
+ */
+class reference_board {
+public:
+	reference_board() : stone(board()), turn(board::black) {}
+
+	unsigned who_take_turns() const { return turn; }
+	board::cell at(int x, int y) const { return stone[x][y]; }
+
+	board::reward place(int x, int y, unsigned who = board::unknown) {
+		if (who == -1u) who = turn;
+		board::reward result = check(x, y, who);
+		if (result != board::legal) return result;
+		saved.push_back(stone);
+		stone[x][y] = who; // is legal move!
+		turn = 3u - who;
+		return board::legal;
+	}
+
+	board::reward check(int x, int y, unsigned who = board::unknown) const {
+		if (who == -1u) who = turn;
+		if (who != turn) return board::illegal_turn;
+		if (x == -1 && y == -1) return board::illegal_pass;
+		if (x < 0 || x >= board::size_x || y < 0 || y >= board::size_y) return board::illegal_out_of_range;
+		if (stone[x][y] == board::hollow) return board::illegal_out_of_range;
+		board::grid test = stone;
+		if (test[x][y] != board::empty) return board::illegal_not_empty;
+		test[x][y] = who; // try put a piece first
+		if (check_liberty(test, x, y, who) == 0) return board::illegal_suicide;
+		unsigned opp = 3u - who;
+		if (x > 0 && check_liberty(test, x - 1, y, opp) == 0) return board::illegal_take;
+		if (x < board::size_x - 1 && check_liberty(test, x + 1, y, opp) == 0) return board::illegal_take;
+		if (y > 0 && check_liberty(test, x, y - 1, opp) == 0) return board::illegal_take;
+		if (y < board::size_y - 1 && check_liberty(test, x, y + 1, opp) == 0) return board::illegal_take;
+		return board::legal;
+	}
+
+	void undo() {
+		stone = saved.back();
+		saved.pop_back();
+		turn = 3u - turn;
+	}
+	int moves() const { return saved.size(); }
+
+	uint64_t hash() const {
+		uint64_t key = board::zobrist(turn);
+		for (int x = 0; x < board::size_x; x++) {
+			for (int y = 0; y < board::size_y; y++) {
+				if (stone[x][y] == board::black || stone[x][y] == board::white) key ^= board::zobrist(x * board::size_y + y, stone[x][y]);
+			}
+		}
+		return key;
+	}
+
+	/**
+	 * the liberties of the block of the piece at [x][y], or -1 if [x][y] is not placed by who
+	 */
+	static int check_liberty(board::grid test, int x, int y, unsigned who) {
+		if (test[x][y] != who) return -1;
+		int liberty = 0;
+		std::list<board::point> check;
+		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
+			int x = check.front().x, y = check.front().y;
+			test[x][y] = board::unknown; // prevent recalculate
+			board::cell near_l = x > 0 ? test[x - 1][y] : -1u; // left
+			if (near_l == board::empty) liberty++;
+			else if (near_l == who) check.emplace_back(x - 1, y);
+			board::cell near_r = x < board::size_x - 1 ? test[x + 1][y] : -1u; // right
+			if (near_r == board::empty) liberty++;
+			else if (near_r == who) check.emplace_back(x + 1, y);
+			board::cell near_d = y > 0 ? test[x][y - 1] : -1u; // down
+			if (near_d == board::empty) liberty++;
+			else if (near_d == who) check.emplace_back(x, y - 1);
+			board::cell near_u = y < board::size_y - 1 ? test[x][y + 1] : -1u; // up
+			if (near_u == board::empty) liberty++;
+			else if (near_u == who) check.emplace_back(x, y + 1);
+		}
+		return liberty;
+	}
+
+private:
+	board::grid stone;
+	unsigned turn;
+	std::vector<board::grid> saved;
+};
+
+/**
+ * play random and MCTS-generated move sequences through both board and reference_board,
+ * and after every step compare the result of the move, the cells, the legal moves of the side
+ * to move (board::check, and position::legal of the bitboards), the hashes
+ * (board::hash, position::key, and the hash computed from scratch), and the 3x3 pattern codes
+ *
+ * the random sequences also try illegal moves, passes, moves of the wrong side, and undo;
+ * every 256th sequence is played by MCTS with a few simulations per move instead
+ * on a mismatch, the sequence is shrunk to a minimal one that still fails, and printed
+ */
+class differential {
+public:
+	/**
+	 * a step of a sequence, a move of a side, a pass (i == -1), or an undo (who == empty)
+	 */
+	typedef std::vector<placement> sequence;
+
+	differential(uint64_t seed = 0) : seed(seed), failed(0) {}
+
+	/**
+	 * run the sequences [0, count) on the given number of threads, return the number that failed
+	 */
+	size_t run(size_t count, size_t jobs, std::ostream& out = std::cout) {
+		std::atomic<size_t> next(0), steps(0);
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < std::max<size_t>(jobs, 1); t++) {
+			workers.emplace_back([&] {
+				for (size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < count; ) {
+					sequence moves = generate(k);
+					steps.fetch_add(moves.size(), std::memory_order_relaxed);
+					if (replay(moves).empty()) continue;
+					sequence shrunk = shrink(moves);
+					std::lock_guard<std::mutex> guard(lock);
+					failed++;
+					out << "mismatch in sequence " << k << " (" << (mcts(k) ? "mcts" : "random") << "), "
+					    << "shrunk from " << moves.size() << " to " << shrunk.size() << " steps:" << std::endl;
+					out << "  " << format(shrunk) << std::endl;
+					out << "  " << replay(shrunk) << std::endl;
+				}
+			});
+		}
+		for (std::thread& t : workers) t.join();
+		out << "differential: " << count << " sequences, " << steps << " steps, " << failed << " mismatches" << std::endl;
+		return failed;
+	}
+
+	/**
+	 * play the sequence through both implementations, return the first mismatch, or an empty string
+	 */
+	static std::string replay(const sequence& moves) {
+		board state;
+		reference_board ref;
+		position pos(state);
+		std::string diff = compare(state, ref, pos);
+		for (size_t k = 0; k < moves.size() && diff.empty(); k++) {
+			const placement& move = moves[k];
+			std::stringstream step;
+			step << "step " << k << " (" << format(move) << "): ";
+			if (move.who == board::empty) {
+				if (!ref.moves() || !state.moves()) continue;
+				ref.undo();
+				state.undo();
+				pos = position(state);
+			} else {
+				int expect = ref.place(move.x, move.y, move.who);
+				int result = state.place(move.x, move.y, move.who);
+				if (result != expect) {
+					step << "place returns " << result << ", the reference " << expect;
+					return step.str();
+				}
+				if (result == board::legal) pos.play(move.i);
+			}
+			diff = compare(state, ref, pos);
+			if (diff.size()) return step.str() + diff;
+		}
+		return diff;
+	}
+
+	/**
+	 * remove chunks of steps, from halves down to pairs (keeping the turns) and single steps,
+	 * as long as the sequence still fails, until no step can be removed
+	 */
+	static sequence shrink(sequence moves) {
+		for (size_t before = 0; before != moves.size(); ) {
+			before = moves.size();
+			for (size_t chunk = std::max<size_t>(moves.size() / 2, 1); chunk; chunk = chunk > 2 ? chunk / 2 : chunk - 1) {
+				for (size_t at = 0; at < moves.size(); ) {
+					sequence test(moves.begin(), moves.begin() + at);
+					test.insert(test.end(), moves.begin() + std::min(at + chunk, moves.size()), moves.end());
+					if (replay(test).size()) moves.swap(test);
+					else at++;
+				}
+			}
+		}
+		return moves;
+	}
+
+	static std::string format(const placement& move) {
+		if (move.who == board::empty) return "undo";
+		return std::string(move.who == board::black ? "B:" : "W:") + std::string(move.position());
+	}
+	static std::string format(const sequence& moves) {
+		std::string text;
+		for (const placement& move : moves) text += (text.size() ? " " : "") + format(move);
+		return text;
+	}
+
+private:
+	static std::string compare(const board& state, const reference_board& ref, const position& pos) {
+		std::stringstream diff;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board::point p(i);
+			if (state[p.x][p.y] != ref.at(p.x, p.y)) {
+				diff << "cell " << p << " is " << state[p.x][p.y] << ", the reference " << ref.at(p.x, p.y);
+				return diff.str();
+			}
+		}
+		if (state.info().who_take_turns != ref.who_take_turns()) return "the side to move differs";
+		board fresh = state;
+		fresh.rehash();
+		if (state.hash() != ref.hash() || fresh.hash() != ref.hash() || pos.key != ref.hash()) {
+			diff << "hash " << std::hex << state.hash() << ", rehash " << fresh.hash()
+			     << ", position " << pos.key << ", the reference " << ref.hash() << std::dec;
+			return diff.str();
+		}
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			if (state.pattern(i) != fresh.pattern(i)) {
+				diff << "pattern of " << board::point(i) << " is " << std::hex << state.pattern(i)
+				     << ", recomputed " << fresh.pattern(i) << std::dec;
+				return diff.str();
+			}
+		}
+		bitboard legal = pos.legal(pos.turn);
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board::point p(i);
+			int expect = ref.check(p.x, p.y), result = state.check(p.x, p.y);
+			if (result != expect) {
+				diff << "check " << p << " returns " << result << ", the reference " << expect;
+				return diff.str();
+			}
+			if (legal.test(i) != (expect == board::legal)) {
+				diff << "position::legal has " << p << (legal.test(i) ? "" : " not") << ", the reference " << expect;
+				return diff.str();
+			}
+		}
+		return {};
+	}
+
+	bool mcts(size_t k) const { return k % 256 == 255; }
+
+	/**
+	 * the k-th sequence, played until the side to move has no legal move
+	 */
+	sequence generate(size_t k) const {
+		std::mt19937 gen(seed * 0x9e3779b9u + k);
+		sequence moves;
+		board state; // only picks the moves, the replay compares it with the reference
+		while (true) {
+			std::vector<int> legal;
+			for (int i = 0; i < board::size_x * board::size_y; i++) {
+				if (state.check(board::point(i)) == board::legal) legal.push_back(i);
+			}
+			if (legal.empty()) break;
+			unsigned who = state.info().who_take_turns;
+			placement move(legal[gen() % legal.size()], who);
+			if (mcts(k)) {
+				MCTS_tree tree(new board(state), state.info().who_take_turns, 0, gen() % 2);
+				tree.grow(32, 1000, 0);
+				MCTS_node* best = tree.select_best_child();
+				if (best) move = best->move;
+			} else {
+				switch (gen() % 16) {
+				case 0: move = placement(gen() % (board::size_x * board::size_y), who); break; // any point
+				case 1: move = placement(gen() % (board::size_x * board::size_y), 3u - who); break; // the wrong side
+				case 2: move = placement(board::point(-1), who); break; // pass
+				case 3: move = placement(); break; // undo
+				}
+			}
+			moves.push_back(move);
+			if (move.who == board::empty) {
+				if (state.moves()) state.undo();
+			} else {
+				move.apply(state);
+			}
+		}
+		return moves;
+	}
+
+private:
+	uint64_t seed;
+	size_t failed;
+	std::mutex lock;
+};
@@ -37,14 +37,20 @@ public:
 		ep_close = { tag, millisec() };
 	}
 	bool apply_action(action move) {
-		board::reward reward = move.apply(state());
+		return apply_action(move, microsec() - ep_time);
+	}
+	/**
+	 * apply a move that took 'usec' microseconds to think, e.g., as measured by the match runner
+	 */
+	bool apply_action(action move, int64_t usec) {
+		board::reward reward = move.type() == action::place::type ? placement(move).apply(state()) : move.apply(state());
 		if (reward != board::legal) return false;
-		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		ep_moves.emplace_back(move, reward, usec / 1000, usec);
 		ep_score += reward;
 		return true;
 	}
 	agent& take_turns(agent& black, agent& white) {
-		ep_time = millisec();
+		ep_time = microsec();
 		return (step() % 2) ? white : black;
 	}
 	agent& last_turns(agent& black, agent& white) {
@@ -83,6 +89,29 @@ public:
 		return time;
 	}
 
+	/**
+	 * the thinking time of each move of a side in microseconds, or in whole milliseconds
+	 * for the moves loaded from a record
+	 */
+	std::vector<int64_t> latencies(unsigned who = -1u) const {
+		std::vector<int64_t> res;
+		switch (who) {
+		case board::black:
+		case action::black::type:
+			for (size_t i = 0; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].usec);
+			break;
+		case board::white:
+		case action::white::type:
+			for (size_t i = 1; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].usec);
+			break;
+		case action::place::type:
+		default:
+			for (const move& mv : ep_moves) res.push_back(mv.usec);
+			break;
+		}
+		return res;
+	}
+
 	std::vector<action> actions(unsigned who = -1u) const {
 		std::vector<action> res;
 		switch (who) {
@@ -151,8 +180,10 @@ protected:
 	struct move {
 		action code;
 		board::reward reward;
-		time_t time;
-		move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
+		time_t time;  // milliseconds, as recorded
+		int64_t usec; // microseconds, as measured
+		move(action code = {}, board::reward reward = 0, time_t time = 0, int64_t usec = 0)
+			: code(code), reward(reward), time(time), usec(usec) {}
 
 		operator action() const { return code; }
 		friend std::ostream& operator <<(std::ostream& out, const move& m) {
@@ -169,6 +200,7 @@ protected:
 				in >> std::dec >> m.time;
 				in.ignore(1); // ]
 			}
+			m.usec = m.time * 1000;
 			return in;
 		}
 	};
@@ -193,12 +225,16 @@ protected:
 		auto now = std::chrono::system_clock::now().time_since_epoch();
 		return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
 	}
+	static int64_t microsec() {
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+	}
 
 private:
 	board ep_state;
 	board::score ep_score;
 	std::vector<move> ep_moves;
-	time_t ep_time;
+	int64_t ep_time; // when the current move started, in microseconds of a monotonic clock
 
 	meta ep_open;
 	meta ep_close;
@@ -0,0 +1,128 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * mast.h: Move-average statistics of the playouts, learned during the search and shared by its threads
+ */
+
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "board.h"
+
+/**
+ * the playout wins and visits of each (side, point), as in the Move-Average Sampling Technique:
+ * the playouts draw a move of a side in proportion to its Gibbs weight exp((Q - 1) / temperature),
+ * where Q is the rate of the playouts the side won after playing the point, 1/2 before any
+ *
+ * each search thread counts into its own copy, which is added to the shared counters by atomic adds
+ * every 'period' playouts and at the end of MCTS_tree::grow, when the thread also takes a new
+ * snapshot of the weights; the player decays the counters before every search
+ */
+class mast_table {
+public:
+	enum { points = board::size_x * board::size_y, period = 64 };
+
+	mast_table(double temperature = 1) : temperature(temperature), epoch(fresh_epoch()) {
+		for (int s = 0; s < 2; s++) {
+			for (int i = 0; i < points; i++) wins[s][i] = 0, visits[s][i] = 0;
+		}
+	}
+
+	/**
+	 * the counts and the weights of the calling thread
+	 */
+	struct local_copy {
+		const mast_table* owner = nullptr;
+		uint32_t epoch = 0;
+		int playouts = 0;
+		uint32_t wins[2][points];   // the counts not yet added to the owner
+		uint32_t visits[2][points];
+		float weight[2][points];    // the Gibbs weights of board::black and board::white moves, in (0, 1]
+	};
+
+	/**
+	 * the copy of the calling thread, taken again if it belongs to another table or precedes a decay
+	 */
+	local_copy& local() const {
+		static thread_local local_copy c;
+		if (c.owner != this || c.epoch != epoch.load(std::memory_order_acquire)) {
+			std::memset(c.wins, 0, sizeof(c.wins));
+			std::memset(c.visits, 0, sizeof(c.visits));
+			c.owner = this;
+			c.playouts = 0;
+			snapshot(c);
+		}
+		return c;
+	}
+
+	/**
+	 * count a playout of n moves, played alternately from the side first
+	 */
+	void update(local_copy& c, const int* moves, int n, unsigned first, unsigned winner) const {
+		for (int k = 0; k < n; k++) {
+			unsigned who = (k % 2 == 0) ? first : 3u - first;
+			c.visits[who - 1][moves[k]]++;
+			c.wins[who - 1][moves[k]] += (who == winner);
+		}
+		if (++c.playouts % period == 0) flush(c);
+	}
+
+	/**
+	 * add the counts of the calling thread to the shared counters, and take a new snapshot of the weights
+	 */
+	void flush() const {
+		local_copy& c = local();
+		if (c.playouts) flush(c);
+	}
+
+	/**
+	 * scale the counts by factor, 0 resets them; called between searches, when no thread is counting
+	 */
+	void decay(double factor) {
+		for (int s = 0; s < 2; s++) {
+			for (int i = 0; i < points; i++) {
+				wins[s][i].store(uint32_t(wins[s][i].load(std::memory_order_relaxed) * factor), std::memory_order_relaxed);
+				visits[s][i].store(uint32_t(visits[s][i].load(std::memory_order_relaxed) * factor), std::memory_order_relaxed);
+			}
+		}
+		epoch.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	/**
+	 * epochs are unique among all tables, so that a table never takes the copy of an earlier one
+	 */
+	static uint32_t fresh_epoch() {
+		static std::atomic<uint32_t> next(1);
+		return next.fetch_add(1 << 16);
+	}
+
+	void flush(local_copy& c) const {
+		for (int s = 0; s < 2; s++) {
+			for (int i = 0; i < points; i++) {
+				if (!c.visits[s][i]) continue;
+				visits[s][i].fetch_add(c.visits[s][i], std::memory_order_relaxed);
+				if (c.wins[s][i]) wins[s][i].fetch_add(c.wins[s][i], std::memory_order_relaxed);
+				c.visits[s][i] = c.wins[s][i] = 0;
+			}
+		}
+		snapshot(c);
+	}
+
+	void snapshot(local_copy& c) const {
+		c.epoch = epoch.load(std::memory_order_acquire);
+		for (int s = 0; s < 2; s++) {
+			for (int i = 0; i < points; i++) {
+				double q = (wins[s][i].load(std::memory_order_relaxed) + 1.0) / (visits[s][i].load(std::memory_order_relaxed) + 2.0);
+				c.weight[s][i] = std::exp((q - 1) / temperature);
+			}
+		}
+	}
+
+private:
+	double temperature;
+	mutable std::atomic<uint32_t> wins[2][points];
+	mutable std::atomic<uint32_t> visits[2][points];
+	std::atomic<uint32_t> epoch;
+};
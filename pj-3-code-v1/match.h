@@ -0,0 +1,249 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * match.h: Native match runner playing games between two GTP engines in parallel
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <iostream>
+#include <csignal>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "action.h"
+#include "episode.h"
+#include "statistics.h"
+
+/**
+ * a GTP engine running as a local subprocess, talking over pipes
+ * the command is run by /bin/sh, the standard error of the engine is discarded
+ */
+class gtp_engine {
+public:
+	gtp_engine(const std::string& command) : command(command), pid(-1), in(-1), out(-1) {}
+	~gtp_engine() { stop(); }
+	gtp_engine(const gtp_engine&) = delete;
+	gtp_engine& operator =(const gtp_engine&) = delete;
+
+	bool alive() const { return pid > 0; }
+
+	bool start() {
+		int up[2], down[2];
+		if (pipe2(up, O_CLOEXEC) != 0) return false;
+		if (pipe2(down, O_CLOEXEC) != 0) {
+			::close(up[0]);
+			::close(up[1]);
+			return false;
+		}
+		pid = fork();
+		if (pid == 0) { // only async-signal-safe calls until exec
+			int null = ::open("/dev/null", O_WRONLY);
+			dup2(down[0], 0);
+			dup2(up[1], 1);
+			if (null >= 0) dup2(null, 2);
+			execl("/bin/sh", "sh", "-c", command.c_str(), (char*) nullptr);
+			_exit(127);
+		}
+		::close(down[0]);
+		::close(up[1]);
+		in = down[1];
+		out = up[0];
+		buffer.clear();
+		if (pid < 0) {
+			stop();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * send a command and wait at most timeout_ms (negative: no limit) for its response
+	 * return false if the engine fails, replies an error, or does not reply in time,
+	 * the reply is stored without the leading '=' or '?'
+	 */
+	bool request(const std::string& cmd, std::string& reply, long timeout_ms = -1) {
+		if (!alive() && !start()) return false;
+		std::string line = cmd + "\n";
+		if (::write(in, line.data(), line.size()) != ssize_t(line.size())) return stop();
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+		for (;;) {
+			// lines before the response, e.g., banners printed to stdout, are skipped
+			while (buffer.size() && buffer[0] != '=' && buffer[0] != '?') {
+				size_t eol = buffer.find('\n');
+				if (eol == std::string::npos) break;
+				buffer.erase(0, eol + 1);
+			}
+			size_t end = buffer.find("\n\n");
+			if (end != std::string::npos && (buffer[0] == '=' || buffer[0] == '?')) {
+				bool success = buffer[0] == '=';
+				reply = buffer.substr(1, end - 1);
+				buffer.erase(0, end + 2);
+				reply.erase(0, reply.find_first_not_of(" \t"));
+				return success;
+			}
+			int wait = -1;
+			if (timeout_ms >= 0) {
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (left <= 0) return stop();
+				wait = left;
+			}
+			struct pollfd fd = { out, POLLIN, 0 };
+			int ready = poll(&fd, 1, wait);
+			if (ready < 0 && errno == EINTR) continue;
+			if (ready <= 0) return stop();
+			char chunk[4096];
+			ssize_t n = ::read(out, chunk, sizeof(chunk));
+			if (n <= 0) return stop();
+			for (ssize_t i = 0; i < n; i++) if (chunk[i] != '\r') buffer.push_back(chunk[i]);
+		}
+	}
+
+	/**
+	 * ask the engine to quit, and kill it if it does not exit in time, always return false
+	 */
+	bool stop() {
+		if (in >= 0) {
+			if (::write(in, "quit\n", 5) < 0) {}
+			::close(in);
+		}
+		if (out >= 0) ::close(out);
+		in = out = -1;
+		if (pid > 0) {
+			for (int i = 0; i < 100 && waitpid(pid, nullptr, WNOHANG) == 0; i++) usleep(10000);
+			if (waitpid(pid, nullptr, WNOHANG) == 0) {
+				kill(pid, SIGKILL);
+				waitpid(pid, nullptr, 0);
+			}
+		}
+		pid = -1;
+		return false;
+	}
+
+private:
+	std::string command;
+	pid_t pid;
+	int in, out;
+	std::string buffer;
+};
+
+/**
+ * play games between two programs, P1 and P2, each given by its black and white engine commands
+ * P1 plays black in the even games and white in the odd games, the games are played by
+ * 'jobs' workers in parallel, each keeping its engines alive across games (clear_board)
+ *
+ * a side loses if it resigns, plays an illegal move (checked by board::place), uses more than
+ * 'limit' milliseconds in total (measured by a monotonic clock), or its engine fails
+ * with a limit, the engines are told their clock by time_settings and time_left (in whole seconds)
+ */
+class match_runner {
+public:
+	match_runner(const std::string& p1b, const std::string& p1w, const std::string& p2b, const std::string& p2w, long limit = 0)
+		: command{ p1b, p1w, p2b, p2w }, limit(limit), next(0), wins{ 0, 0 }, played(0) {}
+
+	/**
+	 * play the remaining games of stats, the finished games are appended as episodes
+	 */
+	void run(statistics& stats, size_t games, int jobs) {
+		std::signal(SIGPIPE, SIG_IGN); // a failed engine is detected by the write instead
+		std::vector<std::thread> workers;
+		for (int i = 0; i < std::max(jobs, 1); i++)
+			workers.emplace_back(&match_runner::work, this, std::ref(stats), games);
+		for (std::thread& t : workers) t.join();
+	}
+
+	/**
+	 * print the win rates of both programs, and the games lost by illegal moves (IA) or time (TLE)
+	 */
+	void summary() const {
+		std::cout << "P1: " << wins[0] << "/" << played << " = " << (played ? wins[0] * 100.0 / played : 0) << "%" << std::endl;
+		std::cout << "P2: " << wins[1] << "/" << played << " = " << (played ? wins[1] * 100.0 / played : 0) << "%" << std::endl;
+		for (const std::string& fault : faults) std::cout << "> " << fault << std::endl;
+	}
+
+private:
+	enum result { normal, illegal, timeout, failure };
+
+	void work(statistics& stats, size_t games) {
+		std::vector<std::unique_ptr<gtp_engine>> engines;
+		for (const std::string& cmd : command) engines.emplace_back(new gtp_engine(cmd));
+		for (size_t index; (index = next++) < games; ) {
+			int p1 = index % 2; // the side P1 plays, 0 for black
+			gtp_engine* side[2] = { engines[p1 ? 2 : 0].get(), engines[p1 ? 1 : 3].get() };
+			std::string label[2] = { p1 ? "P2" : "P1", p1 ? "P1" : "P2" };
+
+			episode game;
+			game.open_episode(label[0] + ":" + label[1]);
+			int loser;
+			result res = play(game, side, loser);
+			game.close_episode(label[!loser]);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			wins[label[!loser] == "P2"]++;
+			played++;
+			const char* reason[] = { "", "IA", "TLE", "failure" };
+			if (res != normal) faults.push_back(std::string(reason[res]) + ": " + "BW"[loser] + "#" + std::to_string(index));
+			std::cerr << "Game " << index << ": " << label[0] << "B vs " << label[1] << "W, " << "BW"[!loser] << "+R"
+			          << (res != normal ? std::string(" (") + reason[res] + ")" : "") << std::endl;
+			stats.add_episode(game);
+		}
+	}
+
+	result play(episode& game, gtp_engine* side[2], int& loser) {
+		std::string reply;
+		for (int s = 0; s < 2; s++) {
+			if (!side[s]->request("boardsize " + std::to_string(board::size_x), reply, 30000) ||
+			    !side[s]->request("clear_board", reply, 30000)) {
+				loser = s;
+				return failure;
+			}
+			// engines without clock commands just reply an error, which is ignored
+			if (limit && !side[s]->request("time_settings " + std::to_string(limit / 1000) + " 0 0", reply, 30000) && !side[s]->alive()) {
+				loser = s;
+				return failure;
+			}
+		}
+		long used[2] = { 0, 0 }; // microseconds
+		for (int turn = 0; ; turn ^= 1) {
+			loser = turn;
+			const char color = "bw"[turn];
+			long left = std::max(limit - used[turn] / 1000, 0L);
+			long wait = limit ? left + grace : -1;
+			if (limit && !side[turn]->request(std::string("time_left ") + color + " " + std::to_string(left / 1000) + " 0", reply, 30000) && !side[turn]->alive())
+				return failure;
+			auto start = std::chrono::steady_clock::now();
+			bool ok = side[turn]->request(std::string("genmove ") + color, reply, wait);
+			long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			used[turn] += elapsed;
+			if (limit && used[turn] > limit * 1000) return timeout;
+			if (!ok) return failure;
+			for (char& c : reply) c = std::toupper(c);
+			if (reply == "RESIGN") return normal;
+			action::place move(board::point(reply), turn ? board::white : board::black);
+			if (!game.apply_action(move, elapsed)) return illegal;
+			if (!side[!turn]->request(std::string("play ") + color + " " + reply, reply, 30000)) {
+				loser = !turn;
+				return failure;
+			}
+		}
+	}
+
+private:
+	static constexpr long grace = 1000; // extra milliseconds to wait for a reply before the engine is killed
+	std::string command[4]; // P1 black, P1 white, P2 black, P2 white
+	long limit;
+	std::atomic<size_t> next;
+	std::mutex mtx;
+	size_t wins[2];
+	size_t played;
+	std::vector<std::string> faults;
+};
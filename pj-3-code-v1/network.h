@@ -0,0 +1,329 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * network.h: Small convolutional policy/value network and a batched evaluator on CPU
+ */
+
+#pragma once
+#include <string>
+#include <array>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * residual-free convolutional network with a policy head and a value head
+ *
+ * input planes (from the view of the side to move), padded by one point on each side:
+ *   0: own stones, 1: opponent stones, 2: legal moves, 3: opponent legal moves, 4: hollow points
+ * trunk: 'layers' 3x3 convolutions with 'filters' channels and ReLU
+ * policy head: 1x1 convolution to one logit per point, softmax over the legal moves
+ * value head: 1x1 convolution with ReLU, a fully connected layer of 'hidden' units with ReLU, and tanh output
+ *
+ * the weight file is "NOGONET1", uint32 layers, filters, hidden, followed by float32 arrays in the order
+ *   conv[0] weight [filters][5][3][3], bias [filters]
+ *   conv[l] weight [filters][filters][3][3], bias [filters] for l = 1 .. layers - 1
+ *   policy weight [filters], bias [1], value weight [filters], bias [1]
+ *   fc1 weight [hidden][81], bias [hidden], fc2 weight [hidden], bias [1]
+ */
+class network {
+public:
+	enum { planes = 5, width = board::size_x + 2, height = board::size_y + 2, area = width * height, points = board::size_x * board::size_y };
+
+	struct output {
+		float policy[points]; // probability of each point, zero for illegal moves
+		float value;          // expected result in [-1, 1] for the side to move
+	};
+
+	enum { max_layers = 64, max_filters = 512, max_hidden = 4096 };
+
+	network() : layers(0), filters(0), hidden(0) {}
+
+	/**
+	 * load a weight file, which must have 1 .. max_layers layers, 1 .. max_filters filters,
+	 * 1 .. max_hidden hidden units, and exactly the weights of this shape after the header
+	 * return false (and leave the network empty) otherwise
+	 */
+	bool load(const std::string& path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!in) return false;
+		std::streamoff length = in.tellg();
+		in.seekg(0);
+		char magic[8];
+		uint32_t dims[3];
+		if (!in.read(magic, 8) || std::memcmp(magic, "NOGONET1", 8) != 0) return false;
+		if (!in.read(reinterpret_cast<char*>(dims), sizeof(dims))) return false;
+		if (dims[0] < 1 || dims[0] > max_layers || dims[1] < 1 || dims[1] > max_filters || dims[2] < 1 || dims[2] > max_hidden) return false;
+		shape(dims[0], dims[1], dims[2]);
+		if (length != std::streamoff(8 + sizeof(dims) + weights.size() * sizeof(float))
+				|| !in.read(reinterpret_cast<char*>(weights.data()), weights.size() * sizeof(float))) {
+			shape(0, 0, 0);
+			weights.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool save(const std::string& path) const {
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		uint32_t dims[3] = { uint32_t(layers), uint32_t(filters), uint32_t(hidden) };
+		out.write("NOGONET1", 8);
+		out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+		out.write(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(float));
+		return bool(out);
+	}
+
+	/**
+	 * give the network the given shape with random weights of a fixed seed (He initialization),
+	 * e.g., as the starting point of training, or to test the evaluator
+	 */
+	void initialize(int l, int f, int h, unsigned seed = 0) {
+		shape(l, f, h);
+		std::mt19937 gen(seed);
+		for (size_t k = 0; k < offsets.size(); k++) {
+			size_t end = k + 1 < offsets.size() ? offsets[k + 1] : weights.size();
+			std::normal_distribution<float> dist(0, std::sqrt(2.0f / fan_in[k]));
+			for (size_t i = offsets[k]; i < end; i++) weights[i] = (k % 2 == 0) ? dist(gen) : 0;
+		}
+	}
+
+	bool empty() const { return weights.empty(); }
+
+	/**
+	 * write the input planes of a board for the side to move
+	 */
+	static void features(const board& b, float* in) {
+		position p(b);
+		bitboard own = p.stones(p.turn), opp = p.stones(position::other(p.turn));
+		bitboard legal = p.legal(p.turn), oppo = p.legal(position::other(p.turn));
+		bitboard hollow = ~position::playable();
+		std::fill(in, in + planes * area, 0.0f);
+		for (int i = 0; i < points; i++) {
+			int k = index(i);
+			in[0 * area + k] = own.test(i);
+			in[1 * area + k] = opp.test(i);
+			in[2 * area + k] = legal.test(i);
+			in[3 * area + k] = oppo.test(i);
+			in[4 * area + k] = hollow.test(i);
+		}
+	}
+
+	/**
+	 * evaluate a batch of inputs, each of planes * area floats
+	 * the layers are computed for the whole batch at once so that each weight is loaded once per batch
+	 */
+	void forward(const float* in, int batch, output* out) const {
+		std::vector<float> a(size_t(batch) * filters * area, 0.0f), b(size_t(batch) * filters * area, 0.0f);
+		convolve(in, planes, a.data(), batch, 0);
+		for (int l = 1; l < layers; l++) {
+			convolve(a.data(), filters, b.data(), batch, l);
+			a.swap(b);
+		}
+		const float* pw = weights.data() + offsets[layers * 2];
+		const float* pb = weights.data() + offsets[layers * 2 + 1];
+		const float* vw = weights.data() + offsets[layers * 2 + 2];
+		const float* vb = weights.data() + offsets[layers * 2 + 3];
+		const float* w1 = weights.data() + offsets[layers * 2 + 4];
+		const float* b1 = weights.data() + offsets[layers * 2 + 5];
+		const float* w2 = weights.data() + offsets[layers * 2 + 6];
+		const float* b2 = weights.data() + offsets[layers * 2 + 7];
+		for (int n = 0; n < batch; n++) {
+			const float* act = a.data() + size_t(n) * filters * area;
+			const float* legal = in + size_t(n) * planes * area + 2 * area;
+			float logit[area], hid[area];
+			std::fill(logit, logit + area, pb[0]);
+			std::fill(hid, hid + area, vb[0]);
+			for (int c = 0; c < filters; c++) {
+				const float* src = act + c * area;
+				for (int k = 0; k < area; k++) {
+					logit[k] += pw[c] * src[k];
+					hid[k] += vw[c] * src[k];
+				}
+			}
+			float sum = 0, top = -1e30f;
+			for (int i = 0; i < points; i++) if (legal[index(i)] > 0) top = std::max(top, logit[index(i)]);
+			for (int i = 0; i < points; i++) {
+				out[n].policy[i] = legal[index(i)] > 0 ? std::exp(logit[index(i)] - top) : 0;
+				sum += out[n].policy[i];
+			}
+			for (int i = 0; i < points; i++) out[n].policy[i] = sum > 0 ? out[n].policy[i] / sum : 0;
+
+			float value = b2[0];
+			for (int h = 0; h < hidden; h++) {
+				float u = b1[h];
+				const float* row = w1 + h * points;
+				for (int i = 0; i < points; i++) u += row[i] * std::max(0.0f, hid[index(i)]);
+				value += w2[h] * std::max(0.0f, u);
+			}
+			out[n].value = std::tanh(value);
+		}
+	}
+
+private:
+	static int index(int i) { return (i / board::size_y + 1) * height + (i % board::size_y + 1); }
+
+	void shape(int l, int f, int h) {
+		layers = l;
+		filters = f;
+		hidden = h;
+		offsets.clear();
+		fan_in.clear();
+		size_t total = 0;
+		auto add = [&](size_t size, int fan) { offsets.push_back(total); fan_in.push_back(fan); total += size; };
+		for (int k = 0; k < layers; k++) {
+			int cin = k ? filters : int(planes);
+			add(size_t(filters) * cin * 9, cin * 9);
+			add(filters, 1);
+		}
+		add(filters, filters);
+		add(1, 1);
+		add(filters, filters);
+		add(1, 1);
+		add(size_t(hidden) * points, points);
+		add(hidden, 1);
+		add(hidden, hidden);
+		add(1, 1);
+		weights.assign(total, 0.0f);
+	}
+
+	/**
+	 * 3x3 convolution with ReLU over padded planes, each kernel weight is applied to the
+	 * points from the first to the last interior one as one contiguous loop vectorized by the
+	 * compiler, whose neighbors all lie within the plane; the padding it writes is cleared afterwards
+	 */
+	void convolve(const float* src, int cin, float* dst, int batch, int layer) const {
+		const float* w = weights.data() + offsets[layer * 2];
+		const float* bias = weights.data() + offsets[layer * 2 + 1];
+		const int begin = height + 1, end = area - height - 1;
+		for (int n = 0; n < batch; n++) {
+			for (int o = 0; o < filters; o++) {
+				float* out = dst + (size_t(n) * filters + o) * area;
+				std::fill(out + begin, out + end, bias[o]);
+			}
+		}
+		for (int o = 0; o < filters; o++) {
+			for (int i = 0; i < cin; i++) {
+				const float* k = w + (size_t(o) * cin + i) * 9;
+				for (int n = 0; n < batch; n++) {
+					const float* in = src + (size_t(n) * cin + i) * area;
+					float* __restrict__ out = dst + (size_t(n) * filters + o) * area;
+					for (int dx = -1; dx <= 1; dx++) {
+						for (int dy = -1; dy <= 1; dy++) {
+							float kw = k[(dx + 1) * 3 + (dy + 1)];
+							const float* __restrict__ nb = in + dx * height + dy;
+							for (int j = begin; j < end; j++) out[j] += kw * nb[j];
+						}
+					}
+				}
+			}
+		}
+		static const std::array<float, area> interior = [] {
+			std::array<float, area> m;
+			m.fill(0);
+			for (int i = 0; i < points; i++) m[index(i)] = 1;
+			return m;
+		}();
+		for (int n = 0; n < batch; n++) {
+			for (int o = 0; o < filters; o++) {
+				float* out = dst + (size_t(n) * filters + o) * area;
+				for (int k = 0; k < area; k++) out[k] = std::max(0.0f, out[k]) * interior[k];
+			}
+		}
+	}
+
+private:
+	int layers, filters, hidden;
+	std::vector<float> weights;
+	std::vector<size_t> offsets;
+	std::vector<int> fan_in;
+};
+
+/**
+ * evaluation queue shared by the search threads
+ * requests are collected into a batch until it is full or no request arrives for wait_us,
+ * then a worker thread evaluates the batch at once and wakes up the waiting threads
+ */
+class evaluator {
+public:
+	evaluator(const std::string& path, int batch = 8, int wait_us = 200) : batch(std::max(batch, 1)), wait_us(wait_us), stop(false) {
+		if (!net.load(path)) throw std::invalid_argument("invalid network: " + path);
+		worker = std::thread(&evaluator::run, this);
+	}
+	~evaluator() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		cv_work.notify_all();
+		worker.join();
+	}
+
+	/**
+	 * evaluate a board for the side to move, block until the batch containing it is done
+	 */
+	network::output evaluate(const board& b) {
+		request req;
+		network::features(b, req.in);
+		std::unique_lock<std::mutex> lock(mtx);
+		queue.push_back(&req);
+		cv_work.notify_one();
+		cv_done.wait(lock, [&] { return req.done; });
+		return req.out;
+	}
+
+private:
+	struct request {
+		float in[network::planes * network::area];
+		network::output out;
+		bool done = false;
+	};
+
+	void run() {
+		std::vector<request*> work;
+		std::vector<float> in;
+		std::vector<network::output> out;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv_work.wait(lock, [&] { return stop || queue.size(); });
+				if (stop) return;
+				for (size_t last = 0; queue.size() < size_t(batch) && queue.size() != last; ) {
+					last = queue.size();
+					cv_work.wait_for(lock, std::chrono::microseconds(wait_us), [&] { return stop || queue.size() >= size_t(batch); });
+				}
+				size_t n = std::min(queue.size(), size_t(batch));
+				work.assign(queue.begin(), queue.begin() + n);
+				queue.erase(queue.begin(), queue.begin() + n);
+			}
+			in.resize(work.size() * network::planes * network::area);
+			out.resize(work.size());
+			for (size_t i = 0; i < work.size(); i++)
+				std::copy(work[i]->in, work[i]->in + network::planes * network::area, in.begin() + i * network::planes * network::area);
+			net.forward(in.data(), work.size(), out.data());
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				for (size_t i = 0; i < work.size(); i++) {
+					work[i]->out = out[i];
+					work[i]->done = true;
+				}
+			}
+			cv_done.notify_all();
+		}
+	}
+
+private:
+	network net;
+	int batch, wait_us;
+	bool stop;
+	std::vector<request*> queue;
+	std::mutex mtx;
+	std::condition_variable cv_work, cv_done;
+	std::thread worker;
+};
@@ -16,6 +16,12 @@
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "book.h"
+#include "match.h"
+#include "coordinator.h"
+#include "bench.h"
+#include "verify.h"
+#include "differential.h"
 
 int main(int argc, const char* argv[]) {
 	//freopen("out.txt","w",stdout);
@@ -26,8 +32,25 @@ int main(int argc, const char* argv[]) {
 	size_t total = 100, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load_path, save_path;
+	std::string latency_path; // the latency histograms of the loaded and saved statistics
+	std::string book_path;
+	size_t book_depth = 12;
+	std::string pattern_path;
+	std::string p1b, p1w, p2b, p2w; // engine commands for the match runner
+	size_t jobs = std::max(std::thread::hardware_concurrency(), 1u);
+	double timelimit = 0;
+	size_t workers = 0; // local worker processes of the self-play coordinator
+	std::string socket_path, connect_path;
+	std::string assist_name; // shared segment to assist the search of another process
+	size_t scaling = 0; // milliseconds per thread count of the scaling measurement
+	std::string affinity = "none";
+	std::string bench_path, baseline_path; // results and baseline of the deterministic benchmark
+	double tolerance = 0.1;
+	bool accept_moves = false; // moves different from the baseline are not a regression
+	std::string verify_path; // records to replay and judge
+	size_t differential_count = 0; // sequences of the differential validation of the board
 	std::string name = "TCG-HollowNoGo-Demo", version = "2022"; // for GTP shell
-	bool shell = false;
+	bool shell = false, match = false;
 	for (int i = 1; i < argc; i++) {
 		std::string arg = argv[i];
 		auto match_arg = [&](std::string flag) -> bool {
@@ -52,27 +75,161 @@ int main(int argc, const char* argv[]) {
 			load_path = next_opt();
 		} else if (match_arg("save")) {
 			save_path = next_opt();
+		} else if (match_arg("latency")) {
+			latency_path = next_opt();
+		} else if (match_arg("make-book")) {
+			book_path = next_opt();
+		} else if (match_arg("book-depth")) {
+			book_depth = std::stoull(next_opt());
+		} else if (match_arg("make-patterns")) {
+			pattern_path = next_opt();
 		} else if (match_arg("name")) {
 			name = next_opt();
 		} else if (match_arg("version")) {
 			version = next_opt();
 		} else if (match_arg("shell")) {
 			shell = true;
+		} else if (match_arg("match")) {
+			match = true;
+		} else if (match_arg("p1b")) {
+			p1b = next_opt();
+		} else if (match_arg("p1w")) {
+			p1w = next_opt();
+		} else if (match_arg("p2b")) {
+			p2b = next_opt();
+		} else if (match_arg("p2w")) {
+			p2w = next_opt();
+		} else if (match_arg("jobs")) {
+			jobs = std::stoull(next_opt());
+		} else if (match_arg("timelimit")) {
+			timelimit = std::stod(next_opt());
+		} else if (match_arg("workers")) {
+			workers = std::stoull(next_opt());
+		} else if (match_arg("socket")) {
+			socket_path = next_opt();
+		} else if (match_arg("connect")) {
+			connect_path = next_opt();
+		} else if (match_arg("assist")) {
+			assist_name = next_opt();
+		} else if (match_arg("scaling")) {
+			scaling = std::stoull(next_opt());
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("bench")) {
+			bench_path = next_opt();
+		} else if (match_arg("baseline")) {
+			baseline_path = next_opt();
+		} else if (match_arg("tolerance")) {
+			tolerance = std::stod(next_opt());
+		} else if (match_arg("accept-moves")) {
+			accept_moves = true;
+		} else if (match_arg("verify")) {
+			verify_path = next_opt();
+		} else if (match_arg("differential")) {
+			differential_count = std::stoull(next_opt());
 		}
 	}
 
+	if (verify_path.size()) { // replay the recorded games and judge them with --timelimit
+		verifier judge(timelimit, jobs);
+		if (!judge.load(verify_path)) return 1;
+		judge.run();
+		return judge.summary() ? 1 : 0;
+	}
+
+	if (differential_count) { // compare the board with the reference rules on random sequences
+		differential harness;
+		return harness.run(differential_count, jobs) ? 1 : 0;
+	}
+
 	statistics stats(total, block, limit);
 
 	if (load_path.size()) {
 		std::ifstream in(load_path, std::ios::in);
 		in >> stats;
 		in.close();
+		if (latency_path.size()) { // the histograms in microseconds, instead of those rebuilt from the move times
+			std::ifstream lat(latency_path, std::ios::in);
+			stats.load_latency(lat);
+		}
 		if (stats.is_finished()) stats.summary();
 	}
 
+	if (book_path.size()) { // build an opening book from the loaded episodes
+		opening_book::builder book;
+		for (size_t i = 0; i < stats.step(); i++) {
+			episode& game = stats.at(i);
+			bool black_win = game.step() % 2 == 1;
+			std::vector<action> moves = game.actions();
+			board state;
+			for (size_t k = 0; k < moves.size() && k < book_depth; k++) {
+				action::place move(moves[k]);
+				book.add(state, move.position().i, (k % 2 == 0) == black_win);
+				move.apply(state);
+			}
+		}
+		book.save(book_path);
+		std::cout << "book: " << book.size() << " entries from " << stats.step() << " games" << std::endl;
+		return 0;
+	}
+
+	if (pattern_path.size()) { // learn the 3x3 pattern weights from the moves of the loaded episodes
+		pattern_table::builder patterns;
+		size_t moves = 0;
+		for (size_t i = 0; i < stats.step(); i++) {
+			board state;
+			for (const action& a : stats.at(i).actions()) {
+				action::place move(a);
+				patterns.add(state, move.position().i);
+				if (move.apply(state) != board::legal) break;
+				moves++;
+			}
+		}
+		patterns.save(pattern_path);
+		std::cout << "patterns: " << patterns.size() << " codes from " << moves << " moves of " << stats.step() << " games" << std::endl;
+		return 0;
+	}
+
+	if (connect_path.size()) { // play the games handed out by a self-play coordinator
+		return coordinator::worker(connect_path) ? 0 : 1;
+	}
+
+	if (bench_path.size()) { // the deterministic benchmark with --jobs threads, compared with --baseline
+		return benchmark::bench(jobs, bench_path, baseline_path, tolerance, accept_moves);
+	}
+
+	if (scaling) { // measure the search speed from 1 to --jobs threads
+		benchmark::scaling(jobs, scaling, affinity);
+		return 0;
+	}
+
+	if (assist_name.size()) { // search the positions of another process, configured by --black
+		player helper("name=helper " + black_args + " role=black");
+		helper.assist(assist_name);
+		return 0;
+	}
+
+	if (!match && (workers || socket_path.size())) { // before the players open their shards or segments
+		for (const std::string& args : { black_args, white_args }) {
+			std::string key = coordinator::unsupported(args);
+			if (key.empty()) continue;
+			std::cerr << "coordinator: " << key << "= is not supported with worker processes" << std::endl;
+			return 1;
+		}
+	}
+
 	player black("name=black " + black_args + " role=black");
 	player white("name=white " + white_args + " role=white");
-	if (!shell) { // launch standard local games
+	if (match) { // play games between two external GTP engines
+		match_runner runner(p1b, p1w, p2b, p2w, timelimit * 1000);
+		runner.run(stats, total, jobs);
+		runner.summary();
+	} else if (workers || socket_path.size()) { // hand out the games to worker processes
+		if (socket_path.empty()) socket_path = "/tmp/nogo-" + std::to_string(getpid()) + ".sock";
+		std::cerr << "coordinator: " << socket_path << std::endl;
+		coordinator coord(socket_path, black_args, white_args);
+		coord.run(stats, total, workers);
+	} else if (!shell) { // launch standard local games
 		while (!stats.is_finished()) {
 			std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
 			black.open_episode("~:" + white.name());
@@ -128,20 +285,10 @@ int main(int argc, const char* argv[]) {
 						std::cout << "= " << "resign" << std::endl << std::endl;
 						// show the error message and terminate the shell
 						std::cerr << who.role() << " plays an illegal action!" << std::endl;
-						const char* reason[] = {
-							"legal",
-							"illegal_turn",
-							"illegal_pass",
-							"illegal_out_of_range",
-							"illegal_not_empty",
-							"illegal_suicide",
-							"illegal_take",
-							"unknown",
-						};
 						std::cerr << "current state: " << std::endl << game.state();
 						int code = move.apply(game.state());
 						std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
-						std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
+						std::cerr << "reason: " << verifier::reason(code) << std::endl;
 						break;
 					}
 				} else if (args[0] == "genmove") { // generate a move and play
@@ -175,6 +322,18 @@ int main(int argc, const char* argv[]) {
 				}
 				if (size > board::size_x || size > board::size_y) break;
 
+			} else if (args[0] == "time_settings" && args.size() >= 4) { // set the main time and byo-yomi of both sides
+				for (player* side : { &black, &white }) {
+					side->notify("byoyomi=" + args[2]);
+					side->notify("byoyomi_stones=" + args[3]);
+					side->notify("time=" + args[1]);
+				}
+
+			} else if (args[0] == "time_left" && args.size() >= 4) { // report the remaining time of a side
+				player& side = std::tolower(args[1][0]) == 'w' ? white : black;
+				side.notify("time_stones=" + args[3]);
+				side.notify("time_left=" + args[2]);
+
 			} else if (args[0] == "name") { // report the name of the program
 				reply = name;
 			} else if (args[0] == "version") { // report the version number of the program
@@ -182,7 +341,7 @@ int main(int argc, const char* argv[]) {
 			} else if (args[0] == "protocol_version") { // report GTP protocol version
 				reply = "2";
 			} else if (args[0] == "list_commands") { // print supported commands
-				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
+				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n" "time_settings\n" "time_left\n"
 				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
 			} else {
 				reply = "unknown command";
@@ -197,6 +356,10 @@ int main(int argc, const char* argv[]) {
 		out << stats;
 		out.close();
 	}
+	if (latency_path.size()) {
+		std::ofstream out(latency_path, std::ios::out | std::ios::trunc);
+		stats.save_latency(out);
+	}
 
 	return 0;
 }
@@ -0,0 +1,125 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * pattern.h: Weights of the 3x3 patterns for the playout policy and the progressive bias of the search
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "board.h"
+
+/**
+ * a weight for each of the 4^8 codes of board::pattern(), seen by black, i.e., the codes of
+ * white to move are looked up with the colors swapped; a move is sampled by the playouts
+ * in proportion to the weight of its pattern
+ *
+ * the built-in table weights all patterns 1, except the points only the side to move can play
+ * (all orthogonal neighbors are its own stones, hollow, or outside the board), which are
+ * filled last; a learned table is a 16-byte header ("NOGOPT01", uint32 code count, uint32 reserved)
+ * followed by the float weights
+ */
+class pattern_table {
+public:
+	enum { codes = 1 << 16 };
+
+	pattern_table() : weights(codes, 1.0f) {
+		for (uint32_t code = 0; code < codes; code++) {
+			if (exclusive(code)) weights[code] = 1.0f / 32;
+		}
+		top = 1.0f;
+	}
+	pattern_table(const std::string& path) : pattern_table() {
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		char magic[8];
+		uint32_t count, reserved;
+		if (!in.read(magic, 8) || std::memcmp(magic, "NOGOPT01", 8) != 0) return;
+		if (!in.read((char*) &count, 4) || !in.read((char*) &reserved, 4) || count != codes) return;
+		std::vector<float> table(codes);
+		if (!in.read((char*) table.data(), codes * sizeof(float))) return;
+		weights.swap(table);
+		top = *std::max_element(weights.begin(), weights.end());
+	}
+
+	float weight(uint16_t code, unsigned who) const { return weights[who == board::white ? swap(code) : code]; }
+	float max() const { return top; }
+
+	/**
+	 * the progressive bias of a move, in [-0.5, 0.5], 0 for a pattern of weight 1
+	 */
+	float bias(uint16_t code, unsigned who) const {
+		float w = weight(code, who);
+		return w / (w + 1) - 0.5f;
+	}
+
+	/**
+	 * swap the black and white stones of a code, i.e., the 2-bit states 1 and 2
+	 */
+	static uint16_t swap(uint16_t code) { return ((code & 0x5555) << 1) | ((code >> 1) & 0x5555); }
+
+	/**
+	 * whether the opponent of black can never play at a point of this code
+	 */
+	static bool exclusive(uint16_t code) {
+		for (int k = 1; k < 8; k += 2) {
+			unsigned c = (code >> (k * 2)) & 3;
+			if (c != board::black && c != board::hollow) return false;
+		}
+		return true;
+	}
+
+	/**
+	 * learn the weights from the moves of recorded games: the weight of a pattern is its rate of
+	 * being played when available, relative to the rate of all patterns, with 4 virtual samples
+	 * of weight 1 for the patterns seldom seen, clamped to [1/64, 16]
+	 */
+	class builder {
+	public:
+		builder() : played(codes, 0), available(codes, 0) {}
+
+		void add(const board& state, int move) {
+			unsigned who = state.info().who_take_turns;
+			for (int i = 0; i < board::size_x * board::size_y; i++) {
+				if (state.check(board::point(i)) != board::legal) continue;
+				uint16_t code = state.pattern(i);
+				if (who == board::white) code = swap(code);
+				available[code]++;
+				if (i == move) played[code]++;
+			}
+		}
+
+		bool save(const std::string& path) const {
+			double rate = 0, moves = 0, total = 0;
+			for (uint32_t code = 0; code < codes; code++) moves += played[code], total += available[code];
+			rate = total ? moves / total : 1;
+			std::vector<float> table(codes);
+			for (uint32_t code = 0; code < codes; code++) {
+				double w = (played[code] + 4 * rate) / (available[code] + 4) / rate;
+				table[code] = std::min(std::max(w, 1.0 / 64), 16.0);
+			}
+			std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+			uint32_t count = codes, reserved = 0;
+			out.write("NOGOPT01", 8);
+			out.write((const char*) &count, 4);
+			out.write((const char*) &reserved, 4);
+			out.write((const char*) table.data(), codes * sizeof(float));
+			return bool(out);
+		}
+
+		size_t size() const {
+			size_t seen = 0;
+			for (uint32_t code = 0; code < codes; code++) seen += available[code] != 0;
+			return seen;
+		}
+
+	private:
+		std::vector<uint64_t> played, available;
+	};
+
+private:
+	std::vector<float> weights;
+	float top;
+};
@@ -0,0 +1,219 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * profile.h: Hot-path profiling counters, compiled in only with -DNOGO_PROFILE (make profile)
+ */
+
+#pragma once
+#include <string>
+#include <iostream>
+
+/**
+ * scoped timers and call counters of the sections of the search, e.g.,
+ *   NOGO_PROFILE_SCOPE(simulate);
+ * counts a call of simulate and the ticks until the end of the enclosing block
+ *
+ * the counters are kept per thread, added to the process totals when a thread exits
+ * (the search threads exit at the end of every move), and printed and reset by report()
+ * the sections nest, e.g., expand includes the simulate and backpropagate of the new node
+ *
+ * if the kernel allows perf_event_open, the cycles, instructions and cache misses
+ * of the threads are counted as well, and reported per playout
+ *
+ * without NOGO_PROFILE, the scopes expand to nothing and report() does nothing
+ */
+#ifdef NOGO_PROFILE
+#include <chrono>
+#include <mutex>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace profile {
+
+enum section { select, expand, simulate, backpropagate, place, check, liberty, sections };
+enum hardware { cycles, instructions, cache_misses, events };
+
+inline const char* name(int s) {
+	static const char* names[] = { "select", "expand", "simulate", "backpropagate", "place", "check", "liberty" };
+	return names[s];
+}
+
+/**
+ * time stamp counter where available, nanoseconds of a monotonic clock otherwise
+ */
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct counters {
+	uint64_t calls[sections];
+	uint64_t spent[sections];
+	uint64_t hw[events];
+	bool hw_valid;
+	counters() { reset(); }
+	void reset() {
+		std::memset(calls, 0, sizeof(calls));
+		std::memset(spent, 0, sizeof(spent));
+		std::memset(hw, 0, sizeof(hw));
+		hw_valid = false;
+	}
+	void add(const counters& c) {
+		for (int s = 0; s < sections; s++) calls[s] += c.calls[s], spent[s] += c.spent[s];
+		for (int e = 0; e < events; e++) hw[e] += c.hw[e];
+		hw_valid |= c.hw_valid;
+	}
+};
+
+/**
+ * the counters of the threads that exited, and the clocks of the last report
+ */
+class totals {
+public:
+	static totals& instance() {
+		static totals t;
+		return t;
+	}
+	void add(const counters& c) {
+		std::lock_guard<std::mutex> guard(lock);
+		sum.add(c);
+	}
+	counters take(double& wall_ms, double& ns_per_tick) {
+		std::lock_guard<std::mutex> guard(lock);
+		auto now = std::chrono::steady_clock::now();
+		uint64_t tick = ticks();
+		wall_ms = std::chrono::duration<double, std::milli>(now - last).count();
+		ns_per_tick = tick > last_tick ? wall_ms * 1e6 / (tick - last_tick) : 1;
+		last = now;
+		last_tick = tick;
+		counters c = sum;
+		sum.reset();
+		return c;
+	}
+private:
+	totals() : last(std::chrono::steady_clock::now()), last_tick(ticks()) {}
+	std::mutex lock;
+	counters sum;
+	std::chrono::steady_clock::time_point last;
+	uint64_t last_tick;
+};
+
+/**
+ * the counters of the calling thread, with its hardware counters if they can be opened
+ */
+class thread_counters : public counters {
+public:
+	thread_counters() {
+		totals::instance(); // the clocks of the first report start with the first thread counted
+		static const uint64_t config[events] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+		for (int e = 0; e < events; e++) {
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = config[e];
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any cpu
+			base[e] = read_event(e);
+		}
+	}
+	~thread_counters() {
+		flush();
+		for (int e = 0; e < events; e++) if (fd[e] >= 0) close(fd[e]);
+	}
+	void flush() {
+		for (int e = 0; e < events; e++) {
+			if (fd[e] < 0) continue;
+			uint64_t now = read_event(e);
+			hw[e] += now - base[e];
+			base[e] = now;
+			hw_valid = true;
+		}
+		totals::instance().add(*this);
+		counters::reset();
+	}
+private:
+	uint64_t read_event(int e) const {
+		uint64_t value = 0;
+		if (fd[e] >= 0 && read(fd[e], &value, sizeof(value)) != sizeof(value)) value = 0;
+		return value;
+	}
+	int fd[events];
+	uint64_t base[events];
+};
+
+inline thread_counters& local() {
+	static thread_local thread_counters c;
+	return c;
+}
+
+class scope {
+public:
+	scope(section s) : c(local()), s(s), start(ticks()) {}
+	~scope() {
+		c.spent[s] += ticks() - start;
+		c.calls[s]++;
+	}
+private:
+	counters& c;
+	section s;
+	uint64_t start;
+};
+
+/**
+ * print the counters since the last report, with the time in milliseconds summed over the threads
+ * and its share of the wall-clock time (over 100% with parallel threads), then reset them
+ */
+inline void report(std::ostream& out, const std::string& who) {
+	local().flush();
+	double wall_ms, ns_per_tick;
+	counters c = totals::instance().take(wall_ms, ns_per_tick);
+	std::ios ff(nullptr);
+	ff.copyfmt(out);
+	out << who << ": profile of " << std::fixed << std::setprecision(1) << wall_ms << " ms, "
+	    << c.calls[simulate] << " playouts" << std::endl;
+	out << "  " << std::left << std::setw(14) << "section" << std::right << std::setw(12) << "calls"
+	    << std::setw(11) << "ms" << std::setw(12) << "ns/call" << std::setw(9) << "share" << std::endl;
+	for (int s = 0; s < sections; s++) {
+		if (!c.calls[s]) continue;
+		double ms = c.spent[s] * ns_per_tick / 1e6;
+		out << "  " << std::left << std::setw(14) << name(s) << std::right << std::setw(12) << c.calls[s]
+		    << std::setw(11) << ms << std::setw(12) << ms * 1e6 / c.calls[s]
+		    << std::setw(8) << (wall_ms > 0 ? ms * 100 / wall_ms : 0) << "%" << std::endl;
+	}
+	if (c.hw_valid && c.calls[simulate]) {
+		double n = c.calls[simulate];
+		out << "  per playout: " << std::setprecision(0) << c.hw[cycles] / n << " cycles, "
+		    << c.hw[instructions] / n << " instructions, " << c.hw[cache_misses] / n << " cache misses" << std::endl;
+	} else if (!c.hw_valid) {
+		out << "  hardware counters unavailable (perf_event_open)" << std::endl;
+	}
+	out.copyfmt(ff);
+}
+
+} // namespace profile
+
+#define NOGO_PROFILE_CONCAT(a, b) a##b
+#define NOGO_PROFILE_NAME(line) NOGO_PROFILE_CONCAT(profile_scope_, line)
+#define NOGO_PROFILE_SCOPE(section) profile::scope NOGO_PROFILE_NAME(__LINE__)(profile::section)
+
+#else
+
+namespace profile {
+inline void report(std::ostream& out, const std::string& who) {}
+} // namespace profile
+
+#define NOGO_PROFILE_SCOPE(section)
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * record.h: Binary shards of self-play training records
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * fixed-size training record of one searched position
+ */
+struct record {
+	uint64_t black[2];          // the black stones, as bitboard words
+	uint64_t white[2];          // the white stones, as bitboard words
+	uint8_t turn;               // the side to move, board::black or board::white
+	int8_t outcome;             // +1 if the side to move won the game, -1 if it lost
+	uint16_t step;              // the number of moves played before this position
+	uint32_t reserved;
+	uint16_t visits[board::size_x * board::size_y]; // root visit distribution, scaled to sum up to about 65535
+	uint8_t padding[6];
+
+	record() { std::memset(this, 0, sizeof(*this)); }
+	record(const board& b, const double* dist) : record() {
+		position p(b);
+		black[0] = p.stones(board::black).lo;
+		black[1] = p.stones(board::black).hi;
+		white[0] = p.stones(board::white).lo;
+		white[1] = p.stones(board::white).hi;
+		turn = p.turn;
+		step = (p.stones(board::black) | p.stones(board::white)).count();
+		for (int i = 0; i < board::size_x * board::size_y; i++) visits[i] = uint16_t(dist[i] * 65535 + 0.5);
+	}
+};
+static_assert(sizeof(record) == 208, "record must stay a fixed-size, 8-byte aligned structure");
+
+/**
+ * a shard is a 64-byte header ("NOGOREC1", uint32 record size, uint32 record count)
+ * followed by the records, hence it can be memory-mapped and indexed directly
+ * the count is rewritten whenever the records are flushed, a reader counts the whole
+ * records in the file instead, so that a shard still being written or left by a crash can be read
+ */
+struct shard_header {
+	char magic[8];
+	uint32_t size;
+	uint32_t count;
+	uint8_t reserved[48];
+};
+static_assert(sizeof(shard_header) == 64, "shard header must be 64 bytes");
+
+/**
+ * asynchronous shard writer
+ * records of finished games are queued by push() and written by a background thread,
+ * a new shard file (prefix-000000.bin, prefix-000001.bin, ...) is started every 'capacity' records
+ */
+class shard_writer {
+public:
+	shard_writer(const std::string& prefix, size_t capacity = 65536)
+		: prefix(prefix), capacity(capacity), file(nullptr), index(0), count(0), stop(false) {
+		worker = std::thread(&shard_writer::run, this);
+	}
+	~shard_writer() {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stop = true;
+		}
+		cv.notify_one();
+		worker.join();
+		finish();
+	}
+
+	/**
+	 * the writer shared by all players writing to the same prefix in this process
+	 */
+	static std::shared_ptr<shard_writer> open(const std::string& prefix) {
+		static std::mutex registry_mtx;
+		static std::map<std::string, std::weak_ptr<shard_writer>> registry;
+		std::lock_guard<std::mutex> lock(registry_mtx);
+		std::shared_ptr<shard_writer> writer = registry[prefix].lock();
+		if (!writer) registry[prefix] = writer = std::make_shared<shard_writer>(prefix);
+		return writer;
+	}
+
+	void push(std::vector<record>&& list) {
+		if (list.empty()) return;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			queue.emplace_back(std::move(list));
+		}
+		cv.notify_one();
+	}
+
+private:
+	void run() {
+		for (;;) {
+			std::vector<std::vector<record>> work;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [&] { return stop || queue.size(); });
+				work.swap(queue);
+				if (work.empty() && stop) return;
+			}
+			for (const std::vector<record>& list : work) {
+				for (const record& rec : list) {
+					if (!file || count == capacity) start();
+					if (!file) continue;
+					std::fwrite(&rec, sizeof(rec), 1, file);
+					count++;
+				}
+			}
+			if (!file) continue;
+			header();
+			std::fflush(file);
+		}
+	}
+
+	void start() {
+		finish();
+		char name[16];
+		std::snprintf(name, sizeof(name), "-%06zu.bin", index++);
+		file = std::fopen((prefix + name).c_str(), "wb");
+		count = 0;
+		if (file) header();
+	}
+
+	void finish() {
+		if (!file) return;
+		header();
+		std::fclose(file);
+		file = nullptr;
+	}
+
+	void header() {
+		shard_header head;
+		std::memset(&head, 0, sizeof(head));
+		std::memcpy(head.magic, "NOGOREC1", 8);
+		head.size = sizeof(record);
+		head.count = count;
+		long pos = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+		std::fwrite(&head, sizeof(head), 1, file);
+		if (pos > long(sizeof(head))) std::fseek(file, pos, SEEK_SET);
+	}
+
+private:
+	std::string prefix;
+	size_t capacity;
+	FILE* file;
+	size_t index;
+	uint32_t count;
+	bool stop;
+	std::vector<std::vector<record>> queue;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::thread worker;
+};
+
+/**
+ * read-only memory-mapped view of a shard
+ */
+class shard {
+public:
+	shard(const std::string& path) : base(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(shard_header)) {
+			void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (addr != MAP_FAILED) {
+				base = static_cast<const char*>(addr);
+				length = st.st_size;
+			}
+		}
+		::close(fd);
+		if (base && (std::memcmp(head().magic, "NOGOREC1", 8) != 0 || head().size != sizeof(record))) {
+			munmap(const_cast<char*>(base), length);
+			base = nullptr;
+		}
+	}
+	~shard() { if (base) munmap(const_cast<char*>(base), length); }
+	shard(const shard&) = delete;
+	shard& operator =(const shard&) = delete;
+
+	bool valid() const { return base; }
+	size_t size() const { return base ? (length - sizeof(shard_header)) / sizeof(record) : 0; }
+	const record& operator [](size_t i) const { return reinterpret_cast<const record*>(base + sizeof(shard_header))[i]; }
+
+private:
+	const shard_header& head() const { return *reinterpret_cast<const shard_header*>(base); }
+
+	const char* base;
+	size_t length;
+};
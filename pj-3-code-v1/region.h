@@ -0,0 +1,78 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * region.h: Decomposition of a position into independent regions
+ */
+
+#pragma once
+#include <vector>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * a set of empty points that does not interact with the rest of the board
+ *
+ * two empty points belong to the same region if they are adjacent, or if they are
+ * liberties of the same block; a move only changes the legality of points next to it
+ * or sharing a block with it, hence the game is the sum of the games in its regions
+ */
+struct region {
+	bitboard area;   // the empty points of the region
+	bitboard blocks; // the stones of the blocks adjacent to the region
+	int black_only;  // points legal only for black
+	int white_only;  // points legal only for white
+	int shared;      // points legal for both sides
+
+	bool settled() const { return !black_only && !white_only && !shared; }
+
+	/**
+	 * identity of the subgame, i.e., the region and the blocks around it
+	 */
+	struct key {
+		bitboard area, black, white;
+		bool operator ==(const key& k) const { return area == k.area && black == k.black && white == k.white; }
+	};
+	key identity(const position& p) const { return { area, p.stones(board::black) & blocks, p.stones(board::white) & blocks }; }
+
+	struct hash {
+		size_t operator ()(const key& k) const {
+			uint64_t h = 0;
+			for (uint64_t w : { k.area.lo, k.area.hi, k.black.lo, k.black.hi, k.white.lo, k.white.hi }) {
+				h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+				h ^= h >> 31;
+			}
+			return h;
+		}
+	};
+};
+
+/**
+ * split the empty points of a position into independent regions
+ */
+inline std::vector<region> regions(const position& p) {
+	bitboard emp = p.empty();
+	bitboard legal_b = p.legal(board::black), legal_w = p.legal(board::white);
+	std::vector<region> list;
+	for (bitboard rest = emp; rest; ) {
+		bitboard area = bitboard::bit(rest.first()), blocks;
+		for (bitboard last; last != area; ) {
+			last = area;
+			blocks = bitboard();
+			for (unsigned c = board::black; c <= board::white; c++) {
+				bitboard own = p.stones(c);
+				bitboard g = area.adjacent() & own;
+				for (bitboard n = (g | g.adjacent()) & own; n != g; n = (g | g.adjacent()) & own) g = n;
+				blocks |= g;
+			}
+			area = (area | area.adjacent() | blocks.adjacent()) & emp;
+		}
+		rest &= ~area;
+		region r;
+		r.area = area;
+		r.blocks = blocks;
+		r.black_only = (area & legal_b & ~legal_w).count();
+		r.white_only = (area & legal_w & ~legal_b).count();
+		r.shared = (area & legal_b & legal_w).count();
+		list.push_back(r);
+	}
+	return list;
+}
@@ -0,0 +1,160 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * shared.h: Shared-memory root statistics of engine processes searching the same position
+ */
+
+#pragma once
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "board.h"
+
+/**
+ * a POSIX shared-memory segment through which one owner process hands out the position
+ * it is thinking on, and helper processes publish the root visits of their own searches
+ *
+ * the position is written under a sequence lock, i.e., its generation is zero while it is written;
+ * each helper owns a cache-line aligned slot of visits tagged by the generation they belong to
+ */
+class shared_root {
+public:
+	enum { points = board::size_x * board::size_y, max_slots = 64 };
+
+	/**
+	 * open (or create) the segment, the owner also unlinks it when it is destroyed
+	 */
+	shared_root(const std::string& name, bool owner) : seg(nullptr), owner(owner), last(0) {
+		int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+		if (fd < 0) return;
+		if (ftruncate(fd, sizeof(segment)) == 0) {
+			void* addr = mmap(nullptr, sizeof(segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (addr != MAP_FAILED) seg = static_cast<segment*>(addr);
+		}
+		::close(fd);
+		if (seg && owner) {
+			this->name = name;
+			last = seg->generation.load();
+			seg->active.store(0);
+			seg->closed.store(0);
+		}
+	}
+	~shared_root() {
+		if (!seg) return;
+		if (owner) {
+			seg->closed.store(1);
+			shm_unlink(name.c_str());
+		}
+		munmap(seg, sizeof(segment));
+	}
+	shared_root(const shared_root&) = delete;
+	shared_root& operator =(const shared_root&) = delete;
+
+	bool valid() const { return seg; }
+
+public: // owner side
+	/**
+	 * hand out a new position to the helpers, return its generation
+	 */
+	uint32_t publish(const board& b) {
+		if (++last == 0) last++; // zero marks a position being written
+		uint32_t gen = last;
+		seg->generation.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (int i = 0; i < points; i++) seg->cells[i].store(b(i), std::memory_order_relaxed);
+		seg->turn.store(b.info().who_take_turns, std::memory_order_relaxed);
+		seg->generation.store(gen, std::memory_order_release);
+		seg->active.store(1, std::memory_order_release);
+		return gen;
+	}
+
+	/**
+	 * let the helpers rest until the next position
+	 */
+	void idle() {
+		seg->active.store(0, std::memory_order_release);
+	}
+
+	/**
+	 * add the visits published by the helpers for generation gen, return the number of helpers merged
+	 */
+	int merge(uint32_t gen, int* visits) const {
+		int merged = 0;
+		int count = std::min<int>(seg->joined.load(), max_slots);
+		for (int k = 0; k < count; k++) {
+			const slot& s = seg->table[k];
+			if (s.generation.load(std::memory_order_acquire) != gen) continue;
+			int local[points];
+			for (int i = 0; i < points; i++) local[i] = s.visits[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (s.generation.load(std::memory_order_relaxed) != gen) continue; // moved on meanwhile
+			for (int i = 0; i < points; i++) visits[i] += local[i];
+			merged++;
+		}
+		return merged;
+	}
+
+public: // helper side
+	/**
+	 * take a slot for publishing visits, return -1 if all slots are taken
+	 */
+	int join() {
+		uint32_t k = seg->joined.fetch_add(1);
+		return k < max_slots ? int(k) : -1;
+	}
+
+	bool closed() const { return seg->closed.load(std::memory_order_acquire); }
+
+	/**
+	 * read the current position, return its generation, or zero if the owner is idle or writing
+	 */
+	uint32_t fetch(board& b) const {
+		if (!seg->active.load(std::memory_order_acquire)) return 0;
+		uint32_t gen = seg->generation.load(std::memory_order_acquire);
+		if (gen == 0) return 0;
+		for (int i = 0; i < points; i++) b(i) = seg->cells[i].load(std::memory_order_relaxed);
+		b.info({ board::piece_type(seg->turn.load(std::memory_order_relaxed)) });
+		b.rehash();
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return seg->generation.load(std::memory_order_relaxed) == gen ? gen : 0;
+	}
+
+	/**
+	 * the generation of the current position, or zero if the owner is idle
+	 */
+	uint32_t current() const {
+		return seg->active.load(std::memory_order_acquire) ? seg->generation.load(std::memory_order_acquire) : 0;
+	}
+
+	void report(int k, uint32_t gen, const int* visits) {
+		slot& s = seg->table[k];
+		if (s.generation.load(std::memory_order_relaxed) != gen) s.generation.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (int i = 0; i < points; i++) s.visits[i].store(visits[i], std::memory_order_relaxed);
+		s.generation.store(gen, std::memory_order_release);
+	}
+
+private:
+	struct alignas(64) slot {
+		std::atomic<uint32_t> generation;
+		std::atomic<uint32_t> visits[points];
+	};
+	struct segment {
+		std::atomic<uint32_t> generation;
+		std::atomic<uint32_t> active;
+		std::atomic<uint32_t> closed;
+		std::atomic<uint32_t> joined;
+		std::atomic<uint32_t> turn;
+		std::atomic<uint32_t> cells[points];
+		slot table[max_slots];
+	};
+
+	segment* seg;
+	bool owner;
+	uint32_t last;
+	std::string name;
+};
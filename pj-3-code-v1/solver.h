@@ -0,0 +1,234 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * solver.h: Exact endgame solver for small positions
+ */
+
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include "board.h"
+#include "bitboard.h"
+#include "region.h"
+
+/**
+ * negamax solver over legal-move bitboards with a Zobrist transposition table
+ * the search gives up (returns unknown) once the node or the time limit is exceeded
+ *
+ * the position is first split into independent regions, each region whose value is an integer
+ * (n free moves for black if n > 0, or -n free moves for white) is evaluated on its own and cached,
+ * the remaining regions are then searched together with the sum of the integers as a move counter
+ */
+class endgame_solver {
+public:
+	enum result { loss = -1, unknown = 0, win = 1 };
+
+	endgame_solver(unsigned tt_bits = 20, int region_limit = 24)
+		: tt_bits(tt_bits), region_limit(region_limit), nodes(0), aborted(false) {}
+
+	/**
+	 * solve the position for the side to move
+	 * return win or loss, or unknown if the search is aborted
+	 * the winning move is stored in best if the result is win
+	 */
+	result solve(const position& p, uint64_t max_nodes, int max_ms, int* best = nullptr) {
+		if (table.empty()) table.resize(size_t(1) << tt_bits);
+		node_limit = max_nodes;
+		deadline = clock::now() + std::chrono::milliseconds(max_ms);
+		nodes = 0;
+		aborted = false;
+
+		std::vector<region> list;
+		for (const region& r : regions(p)) {
+			if (!r.settled()) list.push_back(r);
+		}
+		// the largest region is searched directly, valuing it separately would cost more than that
+		std::sort(list.begin(), list.end(), [](const region& a, const region& b) { return a.area.count() > b.area.count(); });
+
+		int counter = 0;
+		bitboard rest;
+		std::vector<std::pair<region, int>> numbers;
+		for (const region& r : list) {
+			int n;
+			if (rest.empty()) {
+				rest = r.area;
+				continue;
+			}
+			if (integer(p, r, n)) {
+				counter += n;
+				numbers.emplace_back(r, n);
+			} else {
+				rest |= r.area;
+			}
+			if (aborted) return unknown;
+		}
+
+		bitboard moves = p.legal(p.turn) & rest;
+		uint64_t area = hash(rest);
+		for (int mv : ordered(p, moves, rest)) {
+			position next = p;
+			next.play(mv);
+			result r = search(next, rest, area, counter);
+			if (aborted) return unknown;
+			if (r == loss) {
+				if (best) *best = mv;
+				return win;
+			}
+		}
+		if (favours(p.turn, counter)) {
+			position next = skip(p);
+			result r = search(next, rest, area, counter + (p.turn == board::black ? -1 : 1));
+			if (aborted) return unknown;
+			if (r == loss) {
+				int mv = realize(p, numbers);
+				if (aborted || mv == -1) return unknown;
+				if (best) *best = mv;
+				return win;
+			}
+		}
+		return loss;
+	}
+
+	uint64_t searched() const { return nodes; }
+
+private:
+	/**
+	 * try the moves legal for both sides first, since they also take a move from the opponent;
+	 * the moves exclusive to the side to move cannot be taken away and are kept for later
+	 */
+	std::vector<int> ordered(const position& p, const bitboard& moves, const bitboard& area) const {
+		bitboard opp = p.legal(position::other(p.turn)) & area;
+		std::vector<int> list;
+		list.reserve(moves.count());
+		for (bitboard shared = moves & opp; shared; ) list.push_back(shared.pop());
+		for (bitboard exclusive = moves & ~opp; exclusive; ) list.push_back(exclusive.pop());
+		return list;
+	}
+
+	/**
+	 * search the sum of the game restricted to area and an integer counter
+	 * counter > 0 gives black that many free moves, counter < 0 gives them to white
+	 */
+	result search(const position& p, const bitboard& area, uint64_t area_key, int counter) {
+		if ((++nodes & 0xfff) == 0 && (nodes > node_limit || clock::now() > deadline)) aborted = true;
+		if (aborted) return unknown;
+
+		uint64_t key = p.key ^ area_key ^ hash(counter);
+		entry& e = table[key & (table.size() - 1)];
+		if (e.key == key && e.value != unknown) return static_cast<result>(e.value);
+
+		bitboard moves = p.legal(p.turn) & area;
+		result value = loss;
+		for (int mv : ordered(p, moves, area)) {
+			position next = p;
+			next.play(mv);
+			result r = search(next, area, area_key, counter);
+			if (aborted) return unknown;
+			if (r == loss) {
+				value = win;
+				break;
+			}
+		}
+		if (value == loss && favours(p.turn, counter)) {
+			result r = search(skip(p), area, area_key, counter + (p.turn == board::black ? -1 : 1));
+			if (aborted) return unknown;
+			if (r == loss) value = win;
+		}
+		e.key = key;
+		e.value = value;
+		return value;
+	}
+
+	/**
+	 * whether the region r (as game G) plus counter is won by the second player,
+	 * i.e., G >= -counter if white moves first, or G <= -counter if black moves first
+	 */
+	bool second_wins(const position& p, const region& r, unsigned first, int counter) {
+		position q = p;
+		if (q.turn != first) q = skip(q);
+		return search(q, r.area, hash(r.area), counter) == loss;
+	}
+
+	/**
+	 * evaluate a region as an integer if it is one, the result is cached by the region identity
+	 * a game G equals n if and only if G - n is a second-player win
+	 */
+	bool integer(const position& p, const region& r, int& n) {
+		int size = r.area.count();
+		if (size > region_limit) return false;
+		region::key id = r.identity(p);
+		auto it = numbers.find(id);
+		if (it != numbers.end()) {
+			n = it->second;
+			return n != not_integer;
+		}
+		int lo = -size, hi = size; // G + size >= 0 always holds, find the least k with G + k >= 0
+		while (lo < hi) {
+			int k = lo + (hi - lo) / 2;
+			if (second_wins(p, r, board::white, k)) hi = k;
+			else lo = k + 1;
+			if (aborted) return false;
+		}
+		n = second_wins(p, r, board::black, lo) ? -lo : not_integer;
+		if (aborted) return false;
+		numbers[id] = n;
+		return n != not_integer;
+	}
+
+	/**
+	 * find the board move that replaces a counter move, i.e.,
+	 * a move in a region of value n that leaves at least n - 1 for black (or at most n + 1 for white)
+	 */
+	int realize(const position& p, const std::vector<std::pair<region, int>>& list) {
+		bool black = p.turn == board::black;
+		for (const auto& rn : list) {
+			const region& r = rn.first;
+			int n = rn.second;
+			if (!favours(p.turn, n)) continue;
+			for (bitboard moves = p.legal(p.turn) & r.area; moves; ) {
+				int mv = moves.pop();
+				position next = p;
+				next.play(mv);
+				if (second_wins(next, r, next.turn, black ? 1 - n : -1 - n)) return mv;
+				if (aborted) return -1;
+			}
+		}
+		return -1;
+	}
+
+	static bool favours(unsigned who, int counter) {
+		return who == board::black ? counter > 0 : counter < 0;
+	}
+	static position skip(const position& p) {
+		position q = p;
+		q.key ^= position::zobrist(q.turn) ^ position::zobrist(position::other(q.turn));
+		q.turn = position::other(q.turn);
+		return q;
+	}
+	static uint64_t mix(uint64_t x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+	static uint64_t hash(const bitboard& b) { return mix(b.lo) ^ mix(b.hi + 0x632be59bd9b4e019ull); }
+	static uint64_t hash(int counter) { return counter ? mix(uint64_t(counter) * 0xd6e8feb86659fd93ull) : 0; }
+
+private:
+	typedef std::chrono::steady_clock clock;
+	struct entry {
+		uint64_t key = 0;
+		int8_t value = unknown;
+	};
+	enum { not_integer = 1 << 16 };
+
+	unsigned tt_bits;
+	int region_limit;
+	std::vector<entry> table;
+	std::unordered_map<region::key, int, region::hash> numbers;
+	uint64_t nodes;
+	uint64_t node_limit;
+	clock::time_point deadline;
+	bool aborted;
+};
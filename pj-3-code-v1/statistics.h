@@ -11,11 +11,84 @@
 #include <deque>
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
+#include <cmath>
 #include "board.h"
 #include "action.h"
 #include "episode.h"
 
+/**
+ * log-bucketed histogram of move latencies in microseconds, in the style of HDR histograms:
+ * values below 16 have their own buckets, larger values share 16 buckets per power of two,
+ * so a reported percentile is at most 1/16 above the exact one
+ */
+class latency_histogram {
+public:
+	enum { sub_bits = 4, sub_buckets = 1 << sub_bits, buckets = (64 - sub_bits + 1) * sub_buckets };
+
+	latency_histogram() : counts(), total(0), largest(0) {}
+
+	void record(int64_t usec) {
+		uint64_t v = std::max<int64_t>(usec, 0);
+		counts[index(v)]++;
+		total++;
+		largest = std::max(largest, v);
+	}
+
+	uint64_t count() const { return total; }
+	uint64_t max() const { return largest; }
+
+	/**
+	 * the latency at percentile p (0 to 100), i.e., the highest value of the bucket it falls in
+	 */
+	uint64_t percentile(double p) const {
+		uint64_t rank = std::max<uint64_t>(1, std::ceil(p / 100 * total)), seen = 0;
+		for (int i = 0; i < buckets && total; i++) {
+			seen += counts[i];
+			if (seen >= rank) return std::min(highest(i), largest);
+		}
+		return largest;
+	}
+
+	static int index(uint64_t v) {
+		if (v < sub_buckets) return v;
+		int e = 63 - __builtin_clzll(v);
+		return (e - sub_bits + 1) * sub_buckets + ((v >> (e - sub_bits)) & (sub_buckets - 1));
+	}
+	static uint64_t lowest(int i) {
+		if (i < sub_buckets) return i;
+		int e = i / sub_buckets + sub_bits - 1;
+		return uint64_t(sub_buckets + i % sub_buckets) << (e - sub_bits);
+	}
+	static uint64_t highest(int i) {
+		if (i < sub_buckets) return i;
+		int e = i / sub_buckets + sub_bits - 1;
+		return lowest(i) + (uint64_t(1) << (e - sub_bits)) - 1;
+	}
+
+	/**
+	 * the format is "<count> <max> <bucket>:<count> ...", listing the buckets in use
+	 */
+	friend std::ostream& operator <<(std::ostream& out, const latency_histogram& h) {
+		out << h.total << ' ' << h.largest;
+		for (int i = 0; i < buckets; i++) if (h.counts[i]) out << ' ' << i << ':' << h.counts[i];
+		return out;
+	}
+	friend std::istream& operator >>(std::istream& in, latency_histogram& h) {
+		h = {};
+		in >> h.total >> h.largest;
+		for (int i; in >> i && in.ignore(1) && in >> h.counts[std::min<int>(std::max(i, 0), buckets - 1)]; );
+		if (in.eof()) in.clear(std::ios::eofbit);
+		return in;
+	}
+
+private:
+	uint64_t counts[buckets];
+	uint64_t total;
+	uint64_t largest;
+};
+
 class statistics {
 public:
 	/**
@@ -50,32 +123,36 @@ public:
 	 */
 	void show(size_t blk = 0) const {
 		size_t num = std::min(data.size(), blk ?: block);
-		size_t sop = 0, Bop = 0, Wop = 0;
-		time_t sdu = 0, Bdu = 0, Wdu = 0;
-		size_t BW = 0, WW = 0;
-		auto it = data.end();
-		for (size_t i = 0; i < num; i++) {
-			auto& ep = *(--it);
-			if (ep.step() % 2 == 1) BW++;
-			else                    WW++;
-			sop += ep.step();
-			Bop += ep.step(action::black::type);
-			Wop += ep.step(action::white::type);
-			sdu += ep.time();
-			Bdu += ep.time(action::black::type);
-			Wdu += ep.time(action::white::type);
-		}
+		aggregate sum = num == retained.games ? retained : num == recent.games ? recent : tally(num);
 
 		std::cout << count << "\t";
-		std::cout << "win = " << (BW * 100.0 / num) << "%"
-		          <<      "|" << (WW * 100.0 / num) << "%, ";
-		std::cout << "op = "  << (sop * 1.0 / num)
-		          <<     " (" << (Bop * 1.0 / num)
-		          <<      "|" << (Wop * 1.0 / num) << "), ";
-		std::cout << "ops = " << (sop * 1000.0 / sdu)
-		          <<     " (" << (Bop * 1000.0 / Bdu)
-		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
+		std::cout << "win = " << (sum.BW * 100.0 / num) << "%"
+		          <<      "|" << (sum.WW * 100.0 / num) << "%, ";
+		std::cout << "op = "  << (sum.sop * 1.0 / num)
+		          <<     " (" << (sum.Bop * 1.0 / num)
+		          <<      "|" << (sum.Wop * 1.0 / num) << "), ";
+		std::cout << "ops = " << (sum.sop * 1000.0 / sum.sdu)
+		          <<     " (" << (sum.Bop * 1000.0 / sum.Bdu)
+		          <<      "|" << (sum.Wop * 1000.0 / sum.Wdu) << ")";
+		std::cout << std::endl;
+		if (latency[0].count() || latency[1].count()) show_latency();
+	}
+
+	/**
+	 * show the move latencies of all games in milliseconds, black|white, e.g.,
+	 * latency = 12.104|11.776 ms p50, 30.208|29.504 ms p90, 61.440|57.984 ms p99, 97.311|84.226 ms max
+	 */
+	void show_latency() const {
+		std::ios ff(nullptr);
+		ff.copyfmt(std::cout);
+		std::cout << std::fixed << std::setprecision(3) << "latency = ";
+		const char* label[] = { " ms p50, ", " ms p90, ", " ms p99, ", " ms max" };
+		double rank[] = { 50, 90, 99, 100 };
+		for (int k = 0; k < 4; k++) {
+			std::cout << latency[0].percentile(rank[k]) / 1000.0 << "|" << latency[1].percentile(rank[k]) / 1000.0 << label[k];
+		}
 		std::cout << std::endl;
+		std::cout.copyfmt(ff);
 	}
 
 	void summary() const {
@@ -91,14 +168,23 @@ public:
 	}
 
 	void open_episode(const std::string& flag = "") {
-		if (count++ >= limit) data.pop_front();
+		if (count++ >= limit) drop_front();
 		data.emplace_back();
 		data.back().open_episode(flag);
 	}
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
-		if (count % block == 0) show();
+		finish(data.back());
+	}
+
+	/**
+	 * append an episode played elsewhere, e.g., by the match runner
+	 */
+	void add_episode(const episode& ep) {
+		if (count++ >= limit) drop_front();
+		data.push_back(ep);
+		finish(data.back());
 	}
 
 	episode& at(size_t i) {
@@ -114,10 +200,22 @@ public:
 		return count;
 	}
 
+	const latency_histogram& latencies(board::piece_type who) const {
+		return latency[who == board::white];
+	}
+
+	/**
+	 * the episodes, one per line
+	 */
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
 		return out;
 	}
+	/**
+	 * read the episodes up to a blank line or the end, and rebuild the latency histograms from their
+	 * move times (in milliseconds); the histograms that earlier versions appended after a blank line
+	 * are still restored, other lines after it are ignored
+	 */
 	friend std::istream& operator >>(std::istream& in, statistics& stat) {
 		for (std::string line; std::getline(in, line) && line.size(); ) {
 			stat.data.emplace_back();
@@ -125,13 +223,99 @@ public:
 		}
 		stat.total = std::max(stat.total, stat.data.size());
 		stat.count = stat.data.size();
+		stat.retained = stat.recent = {};
+		for (size_t i = 0; i < stat.data.size(); i++) {
+			stat.retained.add(stat.data[i]);
+			if (i >= stat.data.size() - stat.count % stat.block) stat.recent.add(stat.data[i]);
+		}
+		for (int k = 0; k < 2; k++) {
+			stat.latency[k] = {};
+			for (const episode& ep : stat.data)
+				for (int64_t usec : ep.latencies(k ? board::white : board::black)) stat.latency[k].record(usec);
+		}
+		stat.load_latency(in);
 		return in;
 	}
 
+	/**
+	 * the latency histograms of both sides in microseconds, kept apart from the episodes so that
+	 * the saved episodes stay readable by earlier versions, as "latency black|white <histogram>"
+	 */
+	void save_latency(std::ostream& out) const {
+		out << "latency black " << latency[0] << std::endl;
+		out << "latency white " << latency[1] << std::endl;
+	}
+	/**
+	 * replace the histograms by those of save_latency, return whether both sides were found
+	 */
+	bool load_latency(std::istream& in) {
+		bool found[2] = { false, false };
+		for (std::string line; std::getline(in, line); ) {
+			std::stringstream ss(line);
+			std::string type, side;
+			if (!(ss >> type >> side) || type != "latency" || (side != "black" && side != "white")) continue;
+			int k = side == "white";
+			latency_histogram h;
+			if (ss >> h) latency[k] = h, found[k] = true;
+		}
+		return found[0] && found[1];
+	}
+
+private:
+	/**
+	 * running sums of the finished episodes, updated as episodes finish or are dropped,
+	 * so that showing the statistics does not rescan the episodes
+	 */
+	struct aggregate {
+		size_t games, BW, WW, sop, Bop, Wop;
+		time_t sdu, Bdu, Wdu;
+		aggregate() : games(0), BW(0), WW(0), sop(0), Bop(0), Wop(0), sdu(0), Bdu(0), Wdu(0) {}
+		void add(const episode& ep, int sign = 1) {
+			games += sign;
+			if (ep.step() % 2 == 1) BW += sign;
+			else                    WW += sign;
+			sop += sign * ep.step();
+			Bop += sign * ep.step(action::black::type);
+			Wop += sign * ep.step(action::white::type);
+			sdu += sign * ep.time();
+			Bdu += sign * ep.time(action::black::type);
+			Wdu += sign * ep.time(action::white::type);
+		}
+	};
+
+	/**
+	 * the sums of the last num episodes, for blocks other than those kept
+	 */
+	aggregate tally(size_t num) const {
+		aggregate sum;
+		auto it = data.end();
+		for (size_t i = 0; i < num; i++) sum.add(*(--it));
+		return sum;
+	}
+
+	void finish(const episode& ep) {
+		retained.add(ep);
+		recent.add(ep);
+		for (int64_t usec : ep.latencies(board::black)) latency[0].record(usec);
+		for (int64_t usec : ep.latencies(board::white)) latency[1].record(usec);
+		if (count % block == 0) {
+			show();
+			recent = {};
+		}
+	}
+
+	void drop_front() {
+		if (data.front().time() >= 0) retained.add(data.front(), -1); // a finished episode
+		data.pop_front();
+	}
+
 private:
 	size_t total;
 	size_t block;
 	size_t limit;
 	size_t count;
 	std::deque<episode> data;
+	aggregate retained; // the finished episodes in data
+	aggregate recent;   // the episodes finished since the last block was shown
+	latency_histogram latency[2]; // of black and white, over all the games
 };
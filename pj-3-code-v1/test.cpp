@@ -0,0 +1,157 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * test.cpp: Unit tests of the framework, built and run by make test
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <cstdint>
+#include "board.h"
+#include "action.h"
+#include "MCTS.h"
+#include "network.h"
+#include "statistics.h"
+
+static int failures = 0;
+
+#define EXPECT(cond) do { \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": expected " << #cond << std::endl; \
+		failures++; \
+	} \
+} while (0)
+
+/**
+ * the move played by visits must not be a child the solver proved lost, unless every visited child is
+ */
+static void test_most_visited_skips_proven_loss() {
+	seed_random_engines(1);
+	MCTS_tree tree(new board, board::black, 0, false);
+	tree.grow(500, 1 << 30, 0);
+	std::vector<MCTS_tree*> trees(1, &tree);
+	std::vector<int> visits(board::size_x * board::size_y);
+	for (int i = 0; i < int(visits.size()); i++) visits[i] = tree.get_simulation_cnt(i);
+
+	int most = MCTS_tree::most_visited(visits, trees);
+	EXPECT(most != -1);
+	if (most == -1) return;
+	int second = -1;
+	for (int i = 0; i < int(visits.size()); i++) {
+		if (i != most && visits[i] > 0 && (second == -1 || visits[i] > visits[second])) second = i;
+	}
+	tree.root->Map_Action2Child[most]->proven = -1; // the most visited child is proven lost
+	EXPECT(MCTS_tree::most_visited(visits, trees) == second);
+
+	for (auto *ch : *tree.root->child) ch->proven = -1; // every child is proven lost
+	EXPECT(MCTS_tree::most_visited(visits, trees) == most);
+}
+
+/**
+ * sequential halving counts every expansion and iteration it runs, as UCT does
+ */
+static void test_halving_counts_iterations() {
+	seed_random_engines(1);
+	MCTS_tree tree(new board, board::black, 0, false);
+	tree.part = 0;
+	tree.parts = 1;
+	tree.grow(300, 1 << 30, 0);
+	EXPECT(tree.halving_move != -1);
+	EXPECT(tree.iterations == tree.root->number_of_simulations);
+	EXPECT(tree.iterations == tree.playout.playouts);
+	EXPECT(tree.iterations > 81 && tree.iterations <= 300);
+}
+
+static std::string read_file(const std::string& path) {
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::string& data) {
+	std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	out.write(data.data(), data.size());
+}
+
+/**
+ * a saved network loads back to the same outputs, and a file of a wrong shape or size is rejected
+ * the saved file is left as nogo-test.net for the net= game of make test
+ */
+static void test_network_load() {
+	const std::string path = "nogo-test.net", bad = "nogo-test.bad";
+	network net;
+	net.initialize(2, 8, 16, 1);
+	EXPECT(net.save(path));
+
+	network loaded;
+	EXPECT(loaded.load(path));
+	EXPECT(!loaded.empty());
+	board b;
+	float in[network::planes * network::area];
+	network::features(b, in);
+	network::output x, y;
+	net.forward(in, 1, &x);
+	loaded.forward(in, 1, &y);
+	float sum = 0;
+	for (int i = 0; i < network::points; i++) sum += y.policy[i];
+	EXPECT(std::abs(sum - 1) < 1e-4f);
+	EXPECT(y.value >= -1 && y.value <= 1);
+	EXPECT(x.value == y.value && std::equal(x.policy, x.policy + network::points, y.policy));
+
+	std::string data = read_file(path);
+	write_file(bad, data.substr(0, data.size() - 4)); // truncated weights
+	EXPECT(!loaded.load(bad) && loaded.empty());
+	write_file(bad, data + '\0'); // trailing bytes
+	EXPECT(!loaded.load(bad) && loaded.empty());
+	std::string header = data;
+	uint32_t zero = 0;
+	header.replace(8, sizeof(zero), reinterpret_cast<const char*>(&zero), sizeof(zero)); // layers = 0
+	write_file(bad, header);
+	EXPECT(!loaded.load(bad));
+	uint32_t huge = 1u << 30;
+	header.replace(8, sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge)); // layers far too many
+	write_file(bad, header);
+	EXPECT(!loaded.load(bad));
+	EXPECT(!loaded.load("nogo-test.missing"));
+	std::remove(bad.c_str());
+}
+
+/**
+ * a --save file of earlier versions (the episodes only) loads, with the latency histograms rebuilt
+ * from the move times; saving writes the same format, and the histograms go to their own file
+ */
+static void test_statistics_old_format() {
+	const std::string game = "(;FF[4]CA[UTF-8]AP[TCG-NoGo-Demo]SZ[9]KM[0]PB[black]PW[white]DT[2026-10-18]RE[B+R]"
+		"C[TCG|black:white@1000|black@1010];B[ai]C[2];W[ag]C[1];B[ah]C[3])";
+	statistics stats(1);
+	std::stringstream old(game + "\n");
+	old >> stats;
+	EXPECT(stats.step() == 1);
+	EXPECT(stats.latencies(board::black).count() == 2);
+	EXPECT(stats.latencies(board::white).count() == 1);
+	EXPECT(stats.latencies(board::black).percentile(100) >= 3000);
+
+	std::stringstream saved;
+	saved << stats;
+	EXPECT(saved.str().find('\n') == saved.str().size() - 1); // one line per episode, nothing after them
+
+	std::stringstream histograms;
+	stats.save_latency(histograms);
+	statistics loaded(1);
+	std::stringstream again(saved.str());
+	again >> loaded;
+	EXPECT(loaded.load_latency(histograms));
+	EXPECT(loaded.latencies(board::black).count() == 2);
+	EXPECT(loaded.latencies(board::white).percentile(50) == stats.latencies(board::white).percentile(50));
+}
+
+int main(int argc, const char* argv[]) {
+	test_most_visited_skips_proven_loss();
+	test_halving_counts_iterations();
+	test_network_load();
+	test_statistics_old_format();
+	std::cout << (failures ? "test: FAILED, " : "test: passed, ") << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
+}
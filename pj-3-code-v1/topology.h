@@ -0,0 +1,121 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * topology.h: CPU topology and pinning of search threads to cores
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <tuple>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * the cpus this process may run on, with their NUMA node, package and core, as read from sysfs
+ * workers are pinned in one of two orders
+ *   compact: fill the cores (and their hyper-threads) of one node before the next
+ *   scatter: alternate between the nodes, and use distinct cores before hyper-threads
+ */
+class topology {
+public:
+	enum { max_nodes = 8 };
+
+	struct cpu {
+		int id;
+		int node;
+		int package;
+		int core;
+		int thread; // the index of this cpu among the hyper-threads of its core
+	};
+
+	static const topology& instance() {
+		static const topology t;
+		return t;
+	}
+
+	const std::vector<cpu>& cpus() const { return list; }
+	int nodes() const { return num_nodes; }
+
+	/**
+	 * the cpus for the workers 0, 1, 2, ... in the given mode, empty for "none" or unknown modes
+	 */
+	std::vector<int> order(const std::string& mode) const {
+		std::vector<cpu> sorted = list;
+		std::vector<int> res;
+		if (mode == "compact") {
+			std::sort(sorted.begin(), sorted.end(), [](const cpu& a, const cpu& b) {
+				return std::make_tuple(a.node, a.package, a.core, a.thread) < std::make_tuple(b.node, b.package, b.core, b.thread);
+			});
+			for (const cpu& c : sorted) res.push_back(c.id);
+		} else if (mode == "scatter") {
+			std::sort(sorted.begin(), sorted.end(), [](const cpu& a, const cpu& b) {
+				return std::make_tuple(a.thread, a.package, a.core) < std::make_tuple(b.thread, b.package, b.core);
+			});
+			std::vector<std::vector<int>> per_node(num_nodes);
+			for (const cpu& c : sorted) per_node[c.node].push_back(c.id);
+			for (size_t k = 0; res.size() < sorted.size(); k++) {
+				for (const std::vector<int>& node : per_node) if (k < node.size()) res.push_back(node[k]);
+			}
+		}
+		return res;
+	}
+
+	/**
+	 * pin the calling thread to a cpu, its node is then used by current_node()
+	 */
+	bool pin(int id) const {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(id, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) return false;
+		for (const cpu& c : list) if (c.id == id) current_node() = c.node;
+		return true;
+	}
+
+	/**
+	 * the NUMA node of the calling thread, 0 if it is not pinned
+	 */
+	static int& current_node() {
+		static thread_local int node = 0;
+		return node;
+	}
+
+private:
+	topology() : num_nodes(1) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		sched_getaffinity(0, sizeof(set), &set);
+		std::vector<int> node_of(CPU_SETSIZE, 0);
+		for (int n = 0; n < max_nodes; n++) {
+			std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+			std::string ranges;
+			if (!std::getline(in, ranges)) continue;
+			num_nodes = n + 1;
+			std::stringstream ss(ranges);
+			for (std::string range; std::getline(ss, range, ','); ) {
+				int lo = std::stoi(range), hi = range.find('-') != std::string::npos ? std::stoi(range.substr(range.find('-') + 1)) : lo;
+				for (int i = lo; i <= hi && i < CPU_SETSIZE; i++) node_of[i] = n;
+			}
+		}
+		for (int i = 0; i < CPU_SETSIZE; i++) {
+			if (!CPU_ISSET(i, &set)) continue;
+			std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/topology/";
+			cpu c = { i, node_of[i], read(dir + "physical_package_id"), read(dir + "core_id", i), 0 };
+			for (const cpu& o : list) if (o.package == c.package && o.core == c.core) c.thread++;
+			list.push_back(c);
+		}
+	}
+
+	static int read(const std::string& path, int fallback = 0) {
+		std::ifstream in(path);
+		int value;
+		return (in >> value) ? value : fallback;
+	}
+
+private:
+	std::vector<cpu> list;
+	int num_nodes;
+};
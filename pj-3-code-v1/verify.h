@@ -0,0 +1,229 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * verify.h: Replay and judge of recorded games, in the SGF of gogui-twogtp or the episodes of --save
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "board.h"
+
+/**
+ * replay every game found in a directory, a file, or the standard input ("-"), in parallel,
+ * and judge it as run-gogui-twogtp.sh does with nogo-judge
+ *   IA:  a move place() rejects, reported with its nogo_move_result, the rest of the game is not replayed
+ *   TLE: a side whose thinking time exceeds the time limit, summed from the C[ms] of its moves
+ *        (the episodes of --save), or whose time left (BL[s] or WL[s], gogui-twogtp) goes below zero
+ * a game is "(;...)" with its moves ";B[xy]" or ";W[xy]", possibly many games per file or line;
+ * the winner is the side that played last unless RE[] says otherwise, and is re-scored
+ * to the other side if it committed IA or TLE while the other side did not
+ */
+class verifier {
+public:
+	verifier(double timelimit, size_t jobs) : limit_ms(timelimit * 1000), jobs(std::max<size_t>(jobs, 1)) {}
+
+	static const char* reason(int code) {
+		static const char* names[] = {
+			"legal",
+			"illegal_turn",
+			"illegal_pass",
+			"illegal_out_of_range",
+			"illegal_not_empty",
+			"illegal_suicide",
+			"illegal_take",
+			"unknown",
+		};
+		return names[std::min(std::max(-code, 0), 7)];
+	}
+
+	/**
+	 * collect the games of the files in path (not recursively), of path itself, or of the standard input
+	 */
+	bool load(const std::string& path) {
+		if (path == "-") return scan("<stdin>", std::string(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()));
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0) {
+			std::cerr << "verify: cannot open " << path << std::endl;
+			return false;
+		}
+		if (!S_ISDIR(st.st_mode)) return read(path);
+		DIR* dir = ::opendir(path.c_str());
+		if (!dir) return false;
+		std::vector<std::string> names;
+		while (dirent* entry = ::readdir(dir)) {
+			std::string file = path + "/" + entry->d_name;
+			if (entry->d_name[0] != '.' && ::stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) names.push_back(file);
+		}
+		::closedir(dir);
+		std::sort(names.begin(), names.end());
+		for (const std::string& file : names) read(file);
+		return true;
+	}
+
+	/**
+	 * replay and judge the loaded games with the given number of threads
+	 */
+	void run() {
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < std::min(jobs, games.size()); t++) {
+			workers.emplace_back([&] {
+				for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < games.size(); ) judge(games[i]);
+			});
+		}
+		for (std::thread& t : workers) t.join();
+	}
+
+	/**
+	 * print the violations and the re-scored tally, return the number of games with violations
+	 */
+	size_t summary(std::ostream& out = std::cout) const {
+		size_t wins[3] = {}, recorded[3] = {}, illegal = 0, overtime = 0, faulty = 0, changed = 0;
+		for (const game& g : games) {
+			if (g.illegal) {
+				out << "IA: " << side(g.illegal) << "#" << g.ply << " " << g.move << " " << reason(g.code)
+				    << " (" << g.source << ")" << std::endl;
+			}
+			for (unsigned who = board::black; who <= board::white; who++) {
+				if (!(g.overtime & (1u << who))) continue;
+				out << "TLE: " << side(who) << " " << std::fixed << std::setprecision(3);
+				if (g.left[who] < 0) out << g.left[who] << " s left";
+				else out << g.used[who] / 1000 << " s used";
+				out << " (" << g.source << ")" << std::endl;
+				out.unsetf(std::ios::fixed);
+			}
+			illegal += g.illegal != 0;
+			overtime += g.overtime != 0;
+			faulty += g.illegal || g.overtime;
+			changed += g.winner != g.recorded;
+			wins[g.winner]++;
+			recorded[g.recorded]++;
+		}
+		out << "verify: " << games.size() << " games, " << illegal << " with illegal moves, "
+		    << overtime << " over the time limit" << std::endl;
+		out << "recorded: black " << recorded[board::black] << " : white " << recorded[board::white] << std::endl;
+		out << "re-scored: black " << wins[board::black] << " : white " << wins[board::white];
+		if (wins[0]) out << " (" << wins[0] << " without winner)";
+		out << ", " << changed << " results changed" << std::endl;
+		return faulty;
+	}
+
+	size_t size() const { return games.size(); }
+
+private:
+	struct game {
+		std::string source; // file#index
+		std::string text;
+		unsigned illegal = 0;  // the side of the first illegal move, or 0
+		int code = 0;          // its nogo_move_result
+		int ply = 0;           // its index, from 1
+		std::string move;      // its SGF
+		double used[3] = {};   // milliseconds per side
+		double left[3] = {};   // the least time left per side in seconds, if it went below zero
+		unsigned overtime = 0; // 1 << side
+		unsigned recorded = 0; // the winner of RE[], or of the last move if RE[] is missing
+		unsigned winner = 0;   // the re-scored winner, or 0 if both sides broke the rules
+	};
+
+	static const char* side(unsigned who) { return who == board::black ? "B" : "W"; }
+
+	bool read(const std::string& path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		if (!in) {
+			std::cerr << "verify: cannot open " << path << std::endl;
+			return false;
+		}
+		return scan(path, std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()));
+	}
+
+	/**
+	 * split the text into games at every top-level "(;", the latencies saved by --save are skipped
+	 */
+	bool scan(const std::string& source, const std::string& text) {
+		size_t count = 0;
+		for (size_t at = text.find("(;"); at != std::string::npos; ) {
+			size_t end = text.find("(;", at + 2);
+			game g;
+			g.source = source + "#" + std::to_string(count++);
+			g.text = text.substr(at, end == std::string::npos ? end : end - at);
+			games.push_back(std::move(g));
+			at = end;
+		}
+		return count;
+	}
+
+	/**
+	 * the value of the property at text[at], e.g., "C[59]", or an empty string with at unchanged
+	 */
+	static std::string property(const std::string& text, size_t& at, const char* name) {
+		size_t len = std::strlen(name);
+		if (text.compare(at, len, name) != 0 || at + len >= text.size() || text[at + len] != '[') return {};
+		size_t end = text.find(']', at + len);
+		if (end == std::string::npos) return {};
+		std::string value = text.substr(at + len + 1, end - at - len - 1);
+		at = end + 1;
+		return value;
+	}
+
+	void judge(game& g) const {
+		const std::string& text = g.text;
+		board state;
+		unsigned last = 0;
+		int ply = 0;
+		for (size_t at = 0; at < text.size(); at++) {
+			if (text.compare(at, 3, "RE[") == 0 && at + 3 < text.size()) {
+				g.recorded = text[at + 3] == 'B' ? board::black : text[at + 3] == 'W' ? board::white : 0;
+				continue;
+			}
+			if (text[at] != ';' || at + 2 >= text.size() || text[at + 2] != '[') continue;
+			unsigned who = text[at + 1] == 'B' ? board::black : text[at + 1] == 'W' ? board::white : 0;
+			if (!who) continue;
+			size_t end = text.find(']', at);
+			if (end == std::string::npos) break;
+			std::string xy = text.substr(at + 3, end - at - 3);
+			ply++;
+			for (at = end + 1; at < text.size() && (text[at] == 'C' || text[at] == 'B' || text[at] == 'W'); ) {
+				size_t from = at;
+				std::string ms = property(text, at, "C"), left = property(text, at, who == board::black ? "BL" : "WL");
+				if (ms.size() && std::isdigit(ms[0])) g.used[who] += std::strtod(ms.c_str(), nullptr);
+				if (left.size()) g.left[who] = std::min(g.left[who], std::strtod(left.c_str(), nullptr));
+				if (at == from) break;
+			}
+			at--;
+			if ((limit_ms > 0 && g.used[who] > limit_ms) || g.left[who] < 0) g.overtime |= 1u << who;
+			if (g.illegal) continue; // the times of the rest of the game are still counted
+			int x = -1, y = -1; // an empty move or "tt" is a pass
+			if (xy.size() == 2 && xy != "tt") x = xy[0] - 'a', y = (board::size_y - 1) - (xy[1] - 'a');
+			else if (xy.size()) x = y = board::size_x; // out of range
+			int code = state.place(x, y, who);
+			if (code != board::legal) {
+				g.illegal = who;
+				g.code = code;
+				g.ply = ply;
+				g.move = std::string(side(who)) + "[" + xy + "]";
+			}
+			last = who;
+		}
+		if (!g.recorded) g.recorded = last;
+		unsigned fault = (g.illegal ? 1u << g.illegal : 0) | g.overtime;
+		unsigned other = 3u - g.recorded;
+		g.winner = g.recorded;
+		if (g.recorded && (fault & (1u << g.recorded))) g.winner = (fault & (1u << other)) ? 0 : other;
+	}
+
+private:
+	double limit_ms;
+	size_t jobs;
+	std::vector<game> games;
+};